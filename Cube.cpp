@@ -4,6 +4,7 @@
 #include <stdio.h>
 
 #define NUM_TRIS 12
+#define NUM_VERTS 8
 #define VALS_PER_VERT 3
 
 /*
@@ -13,13 +14,13 @@
  * @param width Width of each cube face
  */
 Cube::Cube(float width): 
-	vertCount(NUM_TRIS * VALS_PER_VERT), 
+	vertCount(NUM_VERTS * VALS_PER_VERT), 
 	numTris(NUM_TRIS), 
 	valsPerVert(VALS_PER_VERT), 
 	indCount(NUM_TRIS*3) {
 
 	// Create vertices with given width
-	float cubeVertices[NUM_TRIS * VALS_PER_VERT] = {
+	float cubeVertices[NUM_VERTS * VALS_PER_VERT] = {
 		-width/2.0f, -width/2.0f,  width/2.0f,
 		width/2.0f, -width/2.0f,  width/2.0f,
 		width/2.0f,  width/2.0f,  width/2.0f,
@@ -30,8 +31,8 @@ Cube::Cube(float width):
 		-width/2.0f,  width/2.0f, -width/2.0f
 	};
 
-	vertices = new float[NUM_TRIS * VALS_PER_VERT];
-	std::memcpy(vertices, cubeVertices, NUM_TRIS * VALS_PER_VERT * sizeof(float));
+	vertices = new float[NUM_VERTS * VALS_PER_VERT];
+	std::memcpy(vertices, cubeVertices, NUM_VERTS * VALS_PER_VERT * sizeof(float));
 
 	// 12 triangles - 2 per face of the cube
 	unsigned int cubeIndices[NUM_TRIS * 3] = {
@@ -0,0 +1,21 @@
+/**
+ * Directions the ball can slide in the grid.
+ * The ball starts at row 0, column 0, the NORTH WEST corner. Rows increase
+ * to the SOUTH and columns increase to the EAST.
+ */
+
+#ifndef DIRECTION_H
+#define DIRECTION_H
+
+// 4 directions the ball can move, relative to original camera position
+#define NORTH 0
+#define EAST 1
+#define SOUTH 2
+#define WEST 3
+#define DIRECTION_COUNT 4
+
+// Row and column step of each direction
+const int directionRowSteps[DIRECTION_COUNT] = { -1, 0, 1, 0 };
+const int directionColSteps[DIRECTION_COUNT] = { 0, 1, 0, -1 };
+
+#endif
@@ -0,0 +1,175 @@
+#include "Direction.h"
+#include "DistanceField.h"
+#include "MazeBinary.h"
+#include "Solver.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+static_assert(sizeof(DistanceFileHeader) == 32, "distance file header must have no padding");
+
+DistanceField::DistanceField(): gridSize(0) {
+}
+
+/**
+ * Find the distance of every square, by breadth first search backwards
+ * from the goal with the same searchBackwards() as SOLVER_BFS, but without
+ * stopping at the start. The squares found in each move are kept as
+ * bitmaps until their distance is written.
+ * @param grid Maze, with its columns built
+ * @return false if the maze is bigger than DISTANCE_FIELD_MAX_SIZE, or a
+ *	square is too far from the goal to fit in 16 bits. The field is left empty.
+ */
+bool DistanceField::build(const MazeGrid &grid) {
+	distances.clear();
+	gridSize = grid.size();
+	if (gridSize == 0 || gridSize > DISTANCE_FIELD_MAX_SIZE) {
+		return false;
+	}
+
+	long squares = (long)gridSize * gridSize;
+	long goal = (long)grid.getGoalRow() * gridSize + grid.getGoalCol();
+	std::vector<uint64_t> visited((squares + 63) / 64, 0);
+	SquareBitmap frontier(squares);
+	SquareBitmap next(squares);
+
+	distances.assign(squares, DISTANCE_UNREACHABLE);
+	distances[goal] = 0;
+	visited[goal >> 6] |= 1ull << (goal & 63);
+	frontier.add(goal);
+
+	for (int distance = 1; ; distance++) {
+		searchBackwards(grid, frontier, visited, next, NULL);
+		if (next.empty()) {
+			return true;
+		}
+		if (distance == DISTANCE_UNREACHABLE) {
+			distances.clear();
+			return false;
+		}
+
+		next.forEach([this, distance](long square) {
+			distances[square] = distance;
+		});
+		std::swap(frontier, next);
+	}
+}
+
+/**
+ * Checksum the distances, four to a word
+ */
+static uint64_t distanceChecksum(const std::vector<uint16_t> &distances) {
+	uint64_t checksum = DISTANCE_FILE_VERSION;
+	for (size_t i = 0; i < distances.size(); i += 4) {
+		uint64_t word = 0;
+		memcpy(&word, &distances[i], std::min((size_t)4, distances.size() - i) * sizeof(uint16_t));
+		checksum = checksumWord(checksum, word);
+	}
+	return checksum;
+}
+
+/**
+ * Read a field cached for this maze
+ * @param path Cache file
+ * @param grid Maze the field must have been built for
+ * @return false if there is no cache, or it is for a different maze or damaged.
+ *	The field is left empty.
+ */
+bool DistanceField::load(const char *path, const MazeGrid &grid) {
+	distances.clear();
+	gridSize = grid.size();
+
+	FILE *file = fopen(path, "rb");
+	if (file == NULL) {
+		return false;
+	}
+
+	DistanceFileHeader header;
+	bool ok = fread(&header, sizeof(header), 1, file) == 1 &&
+		memcmp(header.magic, DISTANCE_FILE_MAGIC, DISTANCE_FILE_MAGIC_SIZE) == 0 &&
+		header.version == DISTANCE_FILE_VERSION &&
+		header.size == gridSize &&
+		header.mazeHash == hashMazeGrid(grid);
+	if (ok) {
+		distances.resize((long)gridSize * gridSize);
+		ok = fread(distances.data(), sizeof(uint16_t), distances.size(), file) == distances.size() &&
+			distanceChecksum(distances) == header.checksum;
+	}
+	fclose(file);
+
+	if (!ok) {
+		distances.clear();
+	}
+	return ok;
+}
+
+/**
+ * Write the field to a cache file
+ * It is written under another name first, so a reader never sees half of it.
+ * @param path Cache file
+ * @param grid Maze the field was built for
+ * @param error Set to a message if writing fails
+ * @return true if the file was written
+ */
+bool DistanceField::save(const char *path, const MazeGrid &grid, std::string &error) const {
+	DistanceFileHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, DISTANCE_FILE_MAGIC, DISTANCE_FILE_MAGIC_SIZE);
+	header.version = DISTANCE_FILE_VERSION;
+	header.size = gridSize;
+	header.mazeHash = hashMazeGrid(grid);
+	header.checksum = distanceChecksum(distances);
+
+	std::string partPath = std::string(path) + ".part";
+	FILE *file = fopen(partPath.c_str(), "wb");
+	if (file == NULL) {
+		error = std::string(path) + ": " + strerror(errno);
+		return false;
+	}
+	bool ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+		fwrite(distances.data(), sizeof(uint16_t), distances.size(), file) == distances.size();
+	if (fclose(file) != 0 || !ok || rename(partPath.c_str(), path) != 0) {
+		remove(partPath.c_str());
+		error = std::string(path) + ": couldn't write the whole file";
+		return false;
+	}
+	return true;
+}
+
+/**
+ * Find a move that takes the ball one move closer to the goal
+ * @param grid Maze the field was built for
+ * @return NORTH, EAST, SOUTH or WEST, or -1 on the goal or where it can't be reached
+ */
+int DistanceField::findBestMove(const MazeGrid &grid, int row, int col) const {
+	int distance = getDistance(row, col);
+	if (distance == 0 || distance == DISTANCE_UNREACHABLE) {
+		return -1;
+	}
+
+	for (int direction = 0; direction < DIRECTION_COUNT; direction++) {
+		int stopRow = row;
+		int stopCol = col;
+		grid.slide(direction, stopRow, stopCol);
+		if (getDistance(stopRow, stopCol) == distance - 1) {
+			return direction;
+		}
+	}
+	return -1;
+}
+
+/**
+ * Hash the walls and goal of a maze, which are all its distances depend on
+ */
+uint64_t hashMazeGrid(const MazeGrid &grid) {
+	uint64_t hash = checksumWord(grid.size(), ((uint64_t)grid.getGoalRow() << 32) | grid.getGoalCol());
+	for (int row = 0; row < grid.size(); row++) {
+		const uint64_t *words = grid.getRow(row);
+		for (int word = 0; word < grid.getWordsPerRow(); word++) {
+			hash = checksumWord(hash, words[word]);
+		}
+	}
+	return hash;
+}
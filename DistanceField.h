@@ -0,0 +1,70 @@
+/**
+ * Fewest moves from every square of a maze to its goal.
+ * Built by one breadth first search backwards from the goal, so the game
+ * can give the best next move, or tell that the goal can no longer be
+ * reached, without searching again after each move. Distances are 16 bits
+ * per square, so mazes up to DISTANCE_FIELD_MAX_SIZE take up to 32 MB.
+ *
+ * A field can be cached in a file next to the maze. The file holds a hash
+ * of the walls and goal it was built for, so a cache left behind by an
+ * older version of the maze is ignored. Its layout is a DistanceFileHeader
+ * followed by one little endian 16 bit distance per square, by row.
+ */
+
+#ifndef DISTANCEFIELD_H
+#define DISTANCEFIELD_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "MazeGrid.h"
+
+// Largest maze with a distance field
+#define DISTANCE_FIELD_MAX_SIZE 4096
+// Distance of squares the goal can't be reached from
+#define DISTANCE_UNREACHABLE 0xffff
+
+#define DISTANCE_FILE_MAGIC "MAZEDST\x1a"
+#define DISTANCE_FILE_MAGIC_SIZE 8
+#define DISTANCE_FILE_VERSION 1
+// Added to the maze file's path to name its cache
+#define DISTANCE_FILE_SUFFIX ".dist"
+
+struct DistanceFileHeader {
+	char magic[DISTANCE_FILE_MAGIC_SIZE];
+	uint32_t version;
+	uint32_t size;			// rows and columns
+	uint64_t mazeHash;		// hashMazeGrid() of the maze it was built for
+	uint64_t checksum;		// of the distances
+};
+
+class DistanceField {
+private:
+	int gridSize;
+	std::vector<uint16_t> distances;	// empty until built or loaded
+
+public:
+	DistanceField();
+
+	bool build(const MazeGrid &grid);
+	bool load(const char *path, const MazeGrid &grid);
+	bool save(const char *path, const MazeGrid &grid, std::string &error) const;
+
+	bool isBuilt() const {
+		return !distances.empty();
+	}
+
+	/**
+	 * @return Fewest moves from a square to the goal, or DISTANCE_UNREACHABLE
+	 */
+	int getDistance(int row, int col) const {
+		return distances[(long)row * gridSize + col];
+	}
+
+	int findBestMove(const MazeGrid &grid, int row, int col) const;
+};
+
+uint64_t hashMazeGrid(const MazeGrid &grid);
+
+#endif
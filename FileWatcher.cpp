@@ -0,0 +1,125 @@
+#include "FileWatcher.h"
+
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+/**
+ * Set up watching a file. Nothing is watched until start() is called.
+ * @param path File to watch, which doesn't have to exist yet
+ */
+FileWatcher::FileWatcher(const char *path):
+	inotifyFd(-1) {
+
+	std::string file(path);
+	size_t slash = file.rfind('/');
+	if (slash == std::string::npos) {
+		directory = ".";
+		name = file;
+	} else {
+		directory = slash == 0 ? "/" : file.substr(0, slash);
+		name = file.substr(slash + 1);
+	}
+
+	stopPipe[0] = -1;
+	stopPipe[1] = -1;
+}
+
+FileWatcher::~FileWatcher() {
+	stop();
+}
+
+/**
+ * Start watching on a new thread
+ * @param onChange Called on the watcher's thread each time the file changes
+ * @return false if the directory can't be watched
+ */
+bool FileWatcher::start(std::function<void()> onChange) {
+	this->onChange = onChange;
+
+	inotifyFd = inotify_init1(IN_CLOEXEC);
+	if (inotifyFd == -1) {
+		return false;
+	}
+	if (inotify_add_watch(inotifyFd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) == -1 || 
+		pipe(stopPipe) == -1) {
+		close(inotifyFd);
+		inotifyFd = -1;
+		return false;
+	}
+
+	thread = std::thread(&FileWatcher::watch, this);
+	return true;
+}
+
+/**
+ * Stop watching and wait for the thread to finish
+ * A change being reported is finished first.
+ */
+void FileWatcher::stop() {
+	if (thread.joinable()) {
+		char stopByte = 0;
+		if (write(stopPipe[1], &stopByte, 1) != 1) {
+			// The pipe is empty, so this can't happen
+		}
+		thread.join();
+	}
+
+	if (inotifyFd != -1) {
+		close(inotifyFd);
+		close(stopPipe[0]);
+		close(stopPipe[1]);
+		inotifyFd = -1;
+		stopPipe[0] = -1;
+		stopPipe[1] = -1;
+	}
+}
+
+/**
+ * Read the events waiting on the inotify descriptor
+ * @return true if any of them were for the watched file
+ */
+bool FileWatcher::readEvents() {
+	char buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+	ssize_t length = read(inotifyFd, buffer, sizeof(buffer));
+
+	bool changed = false;
+	for (ssize_t offset = 0; offset < length; ) {
+		struct inotify_event *event = (struct inotify_event *)(buffer + offset);
+		if (event->len > 0 && name == event->name) {
+			changed = true;
+		}
+		offset += sizeof(struct inotify_event) + event->len;
+	}
+	return changed;
+}
+
+/**
+ * Watcher thread: wait for the file to change, then for it to settle
+ */
+void FileWatcher::watch() {
+	struct pollfd fds[2];
+	fds[0].fd = inotifyFd;
+	fds[0].events = POLLIN;
+	fds[1].fd = stopPipe[0];
+	fds[1].events = POLLIN;
+
+	bool pending = false;
+	while (true) {
+		int ready = poll(fds, 2, pending ? FILE_WATCH_SETTLE_MS : -1);
+		if (ready == -1) {
+			continue;	// interrupted by a signal
+		}
+		if (fds[1].revents != 0) {
+			return;
+		}
+
+		if (ready == 0) {
+			// Quiet for long enough, the file should be complete
+			pending = false;
+			onChange();
+		} else if (fds[0].revents != 0) {
+			pending = readEvents() || pending;
+		}
+	}
+}
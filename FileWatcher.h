@@ -0,0 +1,41 @@
+/**
+ * Watches a file for changes with inotify, on its own thread.
+ * The directory holding the file is watched rather than the file itself, so
+ * editors that save by writing a new file and renaming it over the old one
+ * are noticed too. Changes that come close together, like a save written in
+ * several parts, are reported once, after the file has been quiet for
+ * FILE_WATCH_SETTLE_MS.
+ */
+
+#ifndef FILEWATCHER_H
+#define FILEWATCHER_H
+
+#include <functional>
+#include <string>
+#include <thread>
+
+// Time without changes before a change is reported
+#define FILE_WATCH_SETTLE_MS 50
+
+class FileWatcher {
+private:
+	std::string directory, name;
+	int inotifyFd;
+	int stopPipe[2];	// written to by stop() to wake the thread
+	std::thread thread;
+	std::function<void()> onChange;
+
+	bool readEvents();
+	void watch();
+
+public:
+	FileWatcher(const char *path);
+	~FileWatcher();
+	FileWatcher(const FileWatcher &) = delete;
+	FileWatcher &operator=(const FileWatcher &) = delete;
+
+	bool start(std::function<void()> onChange);
+	void stop();
+};
+
+#endif
@@ -0,0 +1,279 @@
+#include "FrameCapture.h"
+
+#include <GL/glew.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+#include <sys/stat.h>
+
+// Longest time the encoder sleeps before checking if it should stop
+#define CAPTURE_IDLE_WAIT_MS 100
+
+/**
+ * Set up capture into a directory. Nothing is captured until start() is called.
+ * @param directory Directory for the images, created if it doesn't exist
+ */
+FrameCapture::FrameCapture(const char *directory):
+	directory(directory),
+	nextPbo(0),
+	queuedFrames(0),
+	running(false),
+	frameCount(0),
+	droppedBusy(0),
+	droppedEncoder(0),
+	framesWritten(0),
+	writeErrors(0) {
+
+	for (int slot = 0; slot < CAPTURE_PBO_COUNT; slot++) {
+		pbos[slot] = 0;
+		fences[slot] = 0;
+		pboFrame[slot] = -1;
+		pboWidth[slot] = 0;
+		pboHeight[slot] = 0;
+		pboSize[slot] = 0;
+	}
+
+	// Every frame starts out free, before the encoder thread exists
+	for (int i = 0; i < CAPTURE_QUEUE_SIZE; i++) {
+		freeQueue.push(&frames[i]);
+	}
+}
+
+FrameCapture::~FrameCapture() {
+	stop();
+}
+
+/**
+ * Create the pixel buffers and start the encoder thread
+ * Needs the OpenGL context that frames will be captured from.
+ * @return false if the directory can't be created
+ */
+bool FrameCapture::start() {
+	mkdir(directory.c_str(), 0755);
+
+	struct stat info;
+	if (stat(directory.c_str(), &info) != 0 || !S_ISDIR(info.st_mode)) {
+		return false;
+	}
+
+	glGenBuffers(CAPTURE_PBO_COUNT, pbos);
+
+	running = true;
+	encoder = std::thread(&FrameCapture::encodeFrames, this);
+	return true;
+}
+
+/**
+ * Start reading the current frame into the next pixel buffer
+ * Call after rendering and before swapping buffers. Never waits for the GPU:
+ * if the next pixel buffer is still being read, this frame is dropped.
+ * @param width Width of the frame in pixels
+ * @param height Height of the frame in pixels
+ */
+void FrameCapture::captureFrame(int width, int height) {
+	if (!running) {
+		return;
+	}
+
+	long frame = frameCount++;
+
+	// Hand over any reads that have finished since the last frame
+	collectFinished(false);
+
+	int slot = nextPbo;
+	if (fences[slot] != 0) {
+		droppedBusy++;
+		return;
+	}
+
+	int size = width * height * 4;
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, pbos[slot]);
+	if (size != pboSize[slot]) {
+		glBufferData(GL_PIXEL_PACK_BUFFER, size, NULL, GL_STREAM_READ);
+		pboSize[slot] = size;
+	}
+
+	// With a pack buffer bound, this starts the read and returns straight away
+	glPixelStorei(GL_PACK_ALIGNMENT, 4);
+	glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	fences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	pboFrame[slot] = frame;
+	pboWidth[slot] = width;
+	pboHeight[slot] = height;
+
+	nextPbo = (slot + 1) % CAPTURE_PBO_COUNT;
+}
+
+/**
+ * Hand finished reads to the encoder, oldest first
+ * @param wait Wait for reads that haven't finished, used when stopping
+ */
+void FrameCapture::collectFinished(bool wait) {
+	for (int i = 0; i < CAPTURE_PBO_COUNT; i++) {
+		int slot = (nextPbo + i) % CAPTURE_PBO_COUNT;
+		if (fences[slot] == 0) {
+			continue;
+		}
+
+		GLsync fence = (GLsync)fences[slot];
+		GLuint64 timeout = wait ? 1000000000ull : 0;
+		GLenum status = glClientWaitSync(fence, wait ? GL_SYNC_FLUSH_COMMANDS_BIT : 0, timeout);
+		if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) {
+			// Reads finish in order, so later ones aren't done either
+			return;
+		}
+
+		readBack(slot);
+	}
+}
+
+/**
+ * Copy a finished read out of its pixel buffer and queue it for the encoder
+ * The pixel buffer is free for another frame afterwards.
+ * @param slot Pixel buffer whose fence has signalled
+ */
+void FrameCapture::readBack(int slot) {
+	glDeleteSync((GLsync)fences[slot]);
+	fences[slot] = 0;
+
+	// Map before taking a free frame, since only the encoder may give one back
+	int size = pboWidth[slot] * pboHeight[slot] * 4;
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, pbos[slot]);
+	void *pixels = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, size, GL_MAP_READ_BIT);
+	if (pixels == NULL) {
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+		droppedEncoder++;
+		return;
+	}
+
+	CapturedFrame *captured;
+	if (!freeQueue.pop(captured)) {
+		glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+		droppedEncoder++;
+		return;
+	}
+
+	captured->frame = pboFrame[slot];
+	captured->width = pboWidth[slot];
+	captured->height = pboHeight[slot];
+	captured->pixels.resize(size);
+	std::memcpy(captured->pixels.data(), pixels, size);
+
+	glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	// Can't fail, there are only as many frames as the queue holds
+	encodeQueue.push(captured);
+	queuedFrames++;
+
+	// Take the lock so an encoder that just found nothing queued is already waiting
+	{
+		std::lock_guard<std::mutex> lock(wakeMutex);
+	}
+	wake.notify_one();
+}
+
+/**
+ * Encoder thread: write queued frames until stopped and the queue is empty
+ */
+void FrameCapture::encodeFrames() {
+	while (true) {
+		CapturedFrame *captured;
+		if (encodeQueue.pop(captured)) {
+			queuedFrames--;
+			if (writePpm(*captured)) {
+				framesWritten++;
+			} else {
+				writeErrors++;
+			}
+			freeQueue.push(captured);
+			continue;
+		}
+
+		if (!running) {
+			return;
+		}
+
+		std::unique_lock<std::mutex> lock(wakeMutex);
+		wake.wait_for(lock, std::chrono::milliseconds(CAPTURE_IDLE_WAIT_MS), [this] {
+			return queuedFrames > 0 || !running;
+		});
+	}
+}
+
+/**
+ * Write a frame as a binary PPM image, flipping it to top row first
+ * @param frame Frame to write
+ * @return false if the file couldn't be written
+ */
+bool FrameCapture::writePpm(CapturedFrame &frame) {
+	char fileName[32];
+	snprintf(fileName, sizeof(fileName), "/frame_%06ld.ppm", frame.frame);
+	std::string path = directory + fileName;
+
+	FILE *file = fopen(path.c_str(), "wb");
+	if (file == NULL) {
+		return false;
+	}
+
+	fprintf(file, "P6\n%d %d\n255\n", frame.width, frame.height);
+
+	std::vector<unsigned char> row(frame.width * 3);
+	bool ok = true;
+	for (int y = frame.height - 1; y >= 0 && ok; y--) {
+		const unsigned char *rgba = &frame.pixels[y * frame.width * 4];
+		for (int x = 0; x < frame.width; x++) {
+			row[x*3] = rgba[x*4];
+			row[x*3 + 1] = rgba[x*4 + 1];
+			row[x*3 + 2] = rgba[x*4 + 2];
+		}
+		ok = fwrite(row.data(), 1, row.size(), file) == row.size();
+	}
+
+	return fclose(file) == 0 && ok;
+}
+
+/**
+ * Finish the reads in flight, write every queued frame and stop the encoder
+ * Needs the OpenGL context that frames were captured from.
+ */
+void FrameCapture::stop() {
+	if (!running) {
+		return;
+	}
+
+	collectFinished(true);
+
+	{
+		std::lock_guard<std::mutex> lock(wakeMutex);
+		running = false;
+	}
+	wake.notify_one();
+	encoder.join();
+
+	for (int slot = 0; slot < CAPTURE_PBO_COUNT; slot++) {
+		if (fences[slot] != 0) {
+			glDeleteSync((GLsync)fences[slot]);
+			fences[slot] = 0;
+		}
+	}
+	glDeleteBuffers(CAPTURE_PBO_COUNT, pbos);
+}
+
+/**
+ * Print how many frames were written and dropped
+ */
+void FrameCapture::printStats() {
+	long dropped = droppedBusy + droppedEncoder;
+	printf("Capture: %ld of %ld frames written to %s, %ld dropped (%ld readback busy, %ld encoder behind)",
+		framesWritten.load(), frameCount, directory.c_str(), dropped, droppedBusy, droppedEncoder);
+	if (writeErrors > 0) {
+		printf(", %ld could not be written", writeErrors.load());
+	}
+	printf("\n");
+}
@@ -0,0 +1,79 @@
+/**
+ * Records rendered frames to a numbered sequence of PPM images.
+ * Frames are read back into a ring of pixel buffer objects, and a fence
+ * tells us when each read has finished, so the render loop never waits for
+ * the GPU. Finished frames are copied out and written by an encoder thread.
+ * If the ring or the encoder falls behind, frames are dropped and counted
+ * rather than slowing down rendering. Dropped frames leave gaps in the
+ * file numbering.
+ */
+
+#ifndef FRAMECAPTURE_H
+#define FRAMECAPTURE_H
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "SpscQueue.h"
+
+// Frames being read back by the GPU at once
+#define CAPTURE_PBO_COUNT 3
+// Frames copied out and waiting to be written
+#define CAPTURE_QUEUE_SIZE 8
+
+class FrameCapture {
+private:
+	struct CapturedFrame {
+		long frame;
+		int width, height;
+		std::vector<unsigned char> pixels;	// RGBA, bottom row first
+	};
+
+	std::string directory;
+
+	// Ring of pixel buffer objects, the oldest read is at nextPbo
+	unsigned int pbos[CAPTURE_PBO_COUNT];
+	void *fences[CAPTURE_PBO_COUNT];	// GLsync, 0 when the buffer is free
+	long pboFrame[CAPTURE_PBO_COUNT];
+	int pboWidth[CAPTURE_PBO_COUNT], pboHeight[CAPTURE_PBO_COUNT];
+	int pboSize[CAPTURE_PBO_COUNT];
+	int nextPbo;
+
+	// Frames go to the encoder and come back empty. The queues hold one less than their size.
+	CapturedFrame frames[CAPTURE_QUEUE_SIZE];
+	SpscQueue<CapturedFrame*, CAPTURE_QUEUE_SIZE + 1> encodeQueue;
+	SpscQueue<CapturedFrame*, CAPTURE_QUEUE_SIZE + 1> freeQueue;
+	std::atomic<int> queuedFrames;
+
+	std::thread encoder;
+	std::atomic<bool> running;
+	std::mutex wakeMutex;
+	std::condition_variable wake;
+
+	long frameCount;
+	long droppedBusy;		// all pixel buffers still being read
+	long droppedEncoder;	// encoder had no free frame
+	std::atomic<long> framesWritten;
+	std::atomic<long> writeErrors;
+
+	void collectFinished(bool wait);
+	void readBack(int slot);
+	void encodeFrames();
+	bool writePpm(CapturedFrame &frame);
+
+public:
+	FrameCapture(const char *directory);
+	~FrameCapture();
+
+	bool start();
+	void captureFrame(int width, int height);
+	void stop();
+
+	void printStats();
+};
+
+#endif
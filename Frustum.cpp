@@ -0,0 +1,62 @@
+#include "Frustum.h"
+
+#include <math.h>
+
+/**
+ * An empty frustum that contains everything
+ */
+Frustum::Frustum() {
+	for (int i = 0; i < 6; i++) {
+		planes[i] = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+	}
+}
+
+/**
+ * Extract the 6 clip planes from a combined projection * view matrix
+ * (Gribb & Hartmann). Each plane is normalised so distances are in world units.
+ * @param viewProjection Projection matrix multiplied by view matrix
+ */
+Frustum::Frustum(glm::mat4 viewProjection) {
+	// glm matrices are column major, so row i is (m[0][i], m[1][i], m[2][i], m[3][i])
+	glm::vec4 rows[4];
+	for (int i = 0; i < 4; i++) {
+		rows[i] = glm::vec4(viewProjection[0][i], viewProjection[1][i], 
+			viewProjection[2][i], viewProjection[3][i]);
+	}
+
+	planes[0] = rows[3] + rows[0];	// left
+	planes[1] = rows[3] - rows[0];	// right
+	planes[2] = rows[3] + rows[1];	// bottom
+	planes[3] = rows[3] - rows[1];	// top
+	planes[4] = rows[3] + rows[2];	// near
+	planes[5] = rows[3] - rows[2];	// far
+
+	for (int i = 0; i < 6; i++) {
+		float length = sqrt(planes[i].x*planes[i].x + planes[i].y*planes[i].y + planes[i].z*planes[i].z);
+		planes[i] = planes[i] / length;
+	}
+}
+
+/**
+ * Test an axis aligned box against the frustum
+ * Only the corner furthest along each plane normal is tested, so a box 
+ * that straddles a plane counts as inside.
+ * @param boxMin Minimum corner of the box
+ * @param boxMax Maximum corner of the box
+ * @return false if the box is completely outside the frustum, true otherwise
+ */
+bool Frustum::intersectsBox(glm::vec3 boxMin, glm::vec3 boxMax) const {
+	for (int i = 0; i < 6; i++) {
+		glm::vec3 positive(
+			planes[i].x >= 0.0f ? boxMax.x : boxMin.x,
+			planes[i].y >= 0.0f ? boxMax.y : boxMin.y,
+			planes[i].z >= 0.0f ? boxMax.z : boxMin.z
+		);
+
+		if (planes[i].x*positive.x + planes[i].y*positive.y + planes[i].z*positive.z + planes[i].w < 0.0f) {
+			return false;
+		}
+	}
+
+	return true;
+}
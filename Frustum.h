@@ -0,0 +1,23 @@
+/**
+ * View frustum planes extracted from a view-projection matrix.
+ * Used to skip parts of the maze that are outside the camera's view.
+ */
+
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include "glm/glm.hpp"
+
+class Frustum {
+private:
+	// left, right, bottom, top, near, far. Normals point into the frustum.
+	glm::vec4 planes[6];
+
+public:
+	Frustum();
+	Frustum(glm::mat4 viewProjection);
+
+	bool intersectsBox(glm::vec3 boxMin, glm::vec3 boxMax) const;
+};
+
+#endif
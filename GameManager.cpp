@@ -1,18 +1,15 @@
+#include "Direction.h"
 #include "GameManager.h"
 #include "Maze.h"
+#include "TileStore.h"
 
 #include <iostream>
+#include <mutex>
 #include <string>
 #include <vector>
 
 #include <GLFW/glfw3.h>
 
-// 4 directions the ball can move, relative to original camera position
-#define NORTH 0
-#define EAST 1
-#define SOUTH 2
-#define WEST 3
-
 // used to find the approximate direction (NESW) the camera is facing
 const float ROTATION_NORTH_WEST = M_PI/4.0f;
 const float ROTATION_SOUTH_WEST = 3.0f*M_PI/4.0f;
@@ -25,11 +22,18 @@ GameManager::GameManager(Maze* maze): maze(maze) {
 
 /**
  * Set the initial game state and ball position.
+ * Called with the maze's worldMutex held, or before the game is shared.
  */
 void GameManager::reset() {
-	maze->ballX = 0;
-	maze->ballY = 0;
+	if (maze->tiles != NULL) {
+		maze->ballX = maze->tiles->getStartRow();
+		maze->ballY = maze->tiles->getStartCol();
+	} else {
+		maze->ballX = maze->grid.getStartRow();
+		maze->ballY = maze->grid.getStartCol();
+	}
 	moves = 0;
+	stuck = false;
 }
 
 /**
@@ -96,6 +100,66 @@ int GameManager::findGridDirection(int key, float cameraRotation) {
 	return gridDirection;
 }
 
+/**
+ * Find the arrow key that moves the ball in a grid direction, the reverse
+ * of findGridDirection()
+ * @return Direction of the arrow key, relative to the camera
+ */
+int GameManager::findKeyDirection(int gridDirection, float cameraRotation) {
+	return (gridDirection + findCameraDirection(cameraRotation)) % 4;
+}
+
+/**
+ * Warn the player once the goal can no longer be reached from the ball
+ * Called with the maze's worldMutex held.
+ */
+void GameManager::checkStuck() {
+	if (!maze->distances.isBuilt()) {
+		return;
+	}
+
+	bool wasStuck = stuck;
+	stuck = maze->distances.getDistance(maze->ballX, maze->ballY) == DISTANCE_UNREACHABLE;
+	if (stuck && !wasStuck) {
+		std::cout << "You are stuck: the goal can't be reached from here any more." << std::endl;
+	}
+}
+
+/**
+ * Print the arrow key of a move that takes the ball closer to the goal,
+ * and how many moves are left
+ * @param cameraRotation How much the camera has been rotated anticlockwise.
+ * 		  Measured in radians from 0 to 2*PI.
+ */
+void GameManager::showHint(float cameraRotation) {
+	const char *keyNames[DIRECTION_COUNT] = { "up", "right", "down", "left" };
+
+	std::lock_guard<std::mutex> lock(maze->worldMutex);
+	if (!maze->distances.isBuilt()) {
+		std::cout << "No hints for this maze." << std::endl;
+		return;
+	}
+
+	int direction = maze->distances.findBestMove(maze->grid, maze->ballX, maze->ballY);
+	if (direction == -1) {
+		std::cout << "Hint: the goal can't be reached from here." << std::endl;
+		return;
+	}
+
+	int distance = maze->distances.getDistance(maze->ballX, maze->ballY);
+	std::cout << "Hint: press " << keyNames[findKeyDirection(direction, cameraRotation)] << ", " 
+		<< distance << (distance == 1 ? " move" : " moves") << " to go." << std::endl;
+}
+
+/**
+ * Check the ball again after the maze was reloaded, since its distances
+ * changed and the ball may have been moved back to the start
+ */
+void GameManager::mazeReloaded() {
+	std::lock_guard<std::mutex> lock(maze->worldMutex);
+	checkStuck();
+}
+
 /**
  * Try to move the ball to a new grid position based on user input.
  * The ball movement is relative to the direction the camera is facing.
@@ -103,67 +167,22 @@ int GameManager::findGridDirection(int key, float cameraRotation) {
  * @param key The GLFW keycode that was pressed by the user.
  * @param cameraRotation How much the camera has been rotated anticlockwise.
  * 		  Measured in radians from 0 to 2*PI.
+ * @return true if the ball moved
  */
-void GameManager::moveBall(int key, float cameraRotation) {
-	char squareType;
+bool GameManager::moveBall(int key, float cameraRotation) {
+	// The maze can be reloaded on the render thread while the ball moves
+	std::lock_guard<std::mutex> lock(maze->worldMutex);
 
 	int newX = maze->ballX;
 	int newY = maze->ballY;
 
+	// slide until the next square is a block or the edge of the maze
+	// A paged maze's grid only holds the window being drawn, so slide through its tiles
 	int gridDirection = findGridDirection(key, cameraRotation);
-	int gridSize = maze->grid.size();
-
-	// move one square at a time while we are not at the edge of the maze
-	// stop moving if we reach a block
-	switch(gridDirection) {
-		case NORTH:
-			while (newX > 0) {
-				squareType = maze->grid.at(newX-1)[maze->ballY];
-				if (squareType == '*') {    // next square is a block
-					break;
-				} else {
-					newX = newX-1;  // move to empty square
-				}
-			}
-			break;
-
-		case SOUTH:
-			while (newX < gridSize-1) {
-				squareType = maze->grid.at(newX+1)[maze->ballY];
-				if (squareType == '*') {    // next square is a block
-					break;
-				} else {
-					newX = newX+1;  // move to empty square
-				}
-			}
-			break;
-
-		case EAST:
-			while (newY < gridSize-1) {
-				squareType = maze->grid.at(maze->ballX)[newY+1];
-				if (squareType == '*') {    // next square is a block
-					break;
-				} else {
-					newY = newY+1;  // move to empty square
-				}
-			}
-			break;
-
-		case WEST:
-			while (newY > 0) {
-				squareType = maze->grid.at(maze->ballX)[newY-1];
-				if (squareType == '*') {    // next square is a block
-					break;
-				} else {
-					newY = newY-1;  // move to empty square
-				}
-			}
-			break;
-
-		default:
-			// You are standing in an open field west of a white house, 
-			// with a boarded front door. There is a small mailbox here.
-			break;
+	if (maze->tiles != NULL) {
+		maze->tiles->slide(gridDirection, newX, newY);
+	} else {
+		maze->grid.slide(gridDirection, newX, newY);
 	}
 
 	// update ball coordinates in maze
@@ -177,6 +196,12 @@ void GameManager::moveBall(int key, float cameraRotation) {
 			std::cout << "Maze completed in " << moves << " moves. Well done!" << std::endl;
 
 			reset();
+		} else {
+			checkStuck();
 		}
+
+		return true;
 	}
+
+	return false;
 }
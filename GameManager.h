@@ -13,15 +13,20 @@
 class GameManager {
 public:
 	GameManager(Maze* maze);
-	void moveBall(int key, float cameraRotation);
+	bool moveBall(int key, float cameraRotation);
+	void showHint(float cameraRotation);
+	void mazeReloaded();
 
 private:
 	Maze* maze;
 	int moves;
+	bool stuck;		// the goal can't be reached from the ball, and the player was told
 
 	void reset();
 	int findCameraDirection(float rotation);
 	int findGridDirection(int key, float cameraRotation);
+	int findKeyDirection(int gridDirection, float cameraRotation);
+	void checkStuck();
 };
 
 #endif
@@ -0,0 +1,238 @@
+#include "GreedyMesher.h"
+#include "Maze.h"
+
+// The two layers of the static world
+#define LAYER_FLOOR 0
+#define LAYER_BLOCKS 1
+
+// Directions a side face can point, in grid terms
+#define SIDE_NORTH 0
+#define SIDE_EAST 1
+#define SIDE_SOUTH 2
+#define SIDE_WEST 3
+
+/**
+ * @param grid Grid of characters that specify the maze
+ * @param cubeWidth Width of each grid square
+ */
+GreedyMesher::GreedyMesher(const MazeGrid &grid, float cubeWidth):
+	GreedyMesher(grid, cubeWidth, grid.size(), grid.size()) {
+}
+
+/**
+ * Mesh a grid that runs past the edge of the maze, such as a tile at the
+ * bottom or right of a paged maze. Squares past the edge are outside the maze.
+ * @param grid Grid of characters that specify the maze
+ * @param cubeWidth Width of each grid square
+ * @param rowCount Rows of the grid inside the maze
+ * @param colCount Columns of the grid inside the maze
+ */
+GreedyMesher::GreedyMesher(const MazeGrid &grid, float cubeWidth, int rowCount, int colCount):
+	grid(grid),
+	cubeWidth(cubeWidth),
+	rowCount(rowCount),
+	colCount(colCount),
+	vertices(NULL),
+	indices(NULL) {
+}
+
+/**
+ * Is this grid square filled in the given layer?
+ * The floor fills every square, blocks fill squares marked '*'.
+ * Squares outside the maze are empty, so the outside faces of the maze are kept.
+ */
+bool GreedyMesher::isSolid(int layer, int row, int col) {
+	if (row < 0 || col < 0 || row >= rowCount || col >= colCount) {
+		return false;
+	}
+
+	if (layer == LAYER_FLOOR) {
+		return true;
+	}
+	return grid.isBlock(row, col);
+}
+
+/**
+ * Can the top of this grid square be seen in the given layer?
+ * The top of the floor is hidden wherever a block sits on it.
+ */
+bool GreedyMesher::isTopVisible(int layer, int row, int col) {
+	if (layer == LAYER_FLOOR) {
+		return !grid.isBlock(row, col);
+	}
+	return isSolid(layer, row, col);
+}
+
+/**
+ * Append one baked vertex
+ */
+void GreedyMesher::addVertex(float x, float y, float z, int renderStage) {
+	vertices->push_back(x);
+	vertices->push_back(y);
+	vertices->push_back(z);
+	vertices->push_back((float)renderStage);
+}
+
+/**
+ * Append an axis aligned quad as two triangles
+ * @param alongX true if the quad is a vertical face along the x axis (z is fixed),
+ * 		  false if it is a vertical face along z (x is fixed).
+ * 		  Horizontal quads have y0 == y1 and ignore this.
+ * @param renderStage Render stage used to colour the quad
+ */
+void GreedyMesher::addQuad(float x0, float y0, float z0, float x1, float y1, float z1, 
+	bool alongX, int renderStage) {
+	unsigned int first = vertices->size() / BAKED_VALS_PER_VERT;
+
+	if (y0 == y1) {
+		addVertex(x0, y0, z0, renderStage);
+		addVertex(x0, y0, z1, renderStage);
+		addVertex(x1, y0, z1, renderStage);
+		addVertex(x1, y0, z0, renderStage);
+	} else if (alongX) {
+		addVertex(x0, y0, z0, renderStage);
+		addVertex(x1, y0, z0, renderStage);
+		addVertex(x1, y1, z0, renderStage);
+		addVertex(x0, y1, z0, renderStage);
+	} else {
+		addVertex(x0, y0, z0, renderStage);
+		addVertex(x0, y0, z1, renderStage);
+		addVertex(x0, y1, z1, renderStage);
+		addVertex(x0, y1, z0, renderStage);
+	}
+
+	unsigned int quadIndices[6] = {0,1,2, 2,3,0};
+	for (int i = 0; i < 6; i++) {
+		indices->push_back(first + quadIndices[i]);
+	}
+}
+
+/**
+ * Cover the visible tops of a layer with as few rectangles as possible
+ * Grow each rectangle along the row first, then down while the whole run is free
+ */
+void GreedyMesher::addTops(int layer, int firstRow, int firstCol, int lastRow, int lastCol) {
+	int rows = lastRow - firstRow + 1;
+	int cols = lastCol - firstCol + 1;
+	std::vector<bool> covered(rows * cols, false);
+
+	float half = cubeWidth/2.0f;
+	float y = (layer == LAYER_FLOOR) ? 0.0f : cubeWidth;
+	int renderStage = (layer == LAYER_FLOOR) ? RENDER_STAGE_FLOOR : RENDER_STAGE_BLOCKS;
+
+	for (int row = firstRow; row <= lastRow; row++) {
+		for (int col = firstCol; col <= lastCol; col++) {
+			if (covered[(row-firstRow)*cols + col-firstCol] || !isTopVisible(layer, row, col)) {
+				continue;
+			}
+
+			// widest run of uncovered squares in this row
+			int endCol = col;
+			while (endCol+1 <= lastCol && !covered[(row-firstRow)*cols + endCol+1-firstCol] 
+				&& isTopVisible(layer, row, endCol+1)) {
+				endCol++;
+			}
+
+			// extend the run down while every square below it is also free
+			int endRow = row;
+			bool canGrow = true;
+			while (canGrow && endRow+1 <= lastRow) {
+				for (int c = col; c <= endCol; c++) {
+					if (covered[(endRow+1-firstRow)*cols + c-firstCol] || !isTopVisible(layer, endRow+1, c)) {
+						canGrow = false;
+						break;
+					}
+				}
+				if (canGrow) {
+					endRow++;
+				}
+			}
+
+			for (int r = row; r <= endRow; r++) {
+				for (int c = col; c <= endCol; c++) {
+					covered[(r-firstRow)*cols + c-firstCol] = true;
+				}
+			}
+
+			addQuad((float)col*cubeWidth - half, y, (float)row*cubeWidth - half, 
+				(float)endCol*cubeWidth + half, y, (float)endRow*cubeWidth + half, 
+				false, renderStage);
+		}
+	}
+}
+
+/**
+ * Add the side faces of a layer that are not hidden by a neighbour
+ * Neighbouring exposed faces along the same edge are merged into one quad
+ */
+void GreedyMesher::addSides(int layer, int firstRow, int firstCol, int lastRow, int lastCol) {
+	float half = cubeWidth/2.0f;
+	float bottom = (layer == LAYER_FLOOR) ? -half : 0.0f;
+	float top = (layer == LAYER_FLOOR) ? 0.0f : cubeWidth;
+	int renderStage = (layer == LAYER_FLOOR) ? RENDER_STAGE_FLOOR : RENDER_STAGE_BLOCKS;
+
+	int rowStep[4] = {-1, 0, 1, 0};
+	int colStep[4] = {0, 1, 0, -1};
+
+	for (int side = SIDE_NORTH; side <= SIDE_WEST; side++) {
+		bool alongX = (side == SIDE_NORTH || side == SIDE_SOUTH);
+
+		// Walk each line of squares parallel to the face
+		int lineFirst = alongX ? firstRow : firstCol;
+		int lineLast = alongX ? lastRow : lastCol;
+		int runFirst = alongX ? firstCol : firstRow;
+		int runLast = alongX ? lastCol : lastRow;
+
+		for (int line = lineFirst; line <= lineLast; line++) {
+			int start = -1;
+
+			for (int i = runFirst; i <= runLast + 1; i++) {
+				bool exposed = false;
+				if (i <= runLast) {
+					int row = alongX ? line : i;
+					int col = alongX ? i : line;
+					exposed = isSolid(layer, row, col) 
+						&& !isSolid(layer, row + rowStep[side], col + colStep[side]);
+				}
+
+				if (exposed && start == -1) {
+					start = i;
+				} else if (!exposed && start != -1) {
+					// face of the run lies half a square from the centre of the line
+					float fixed = (float)line*cubeWidth + 
+						((side == SIDE_NORTH || side == SIDE_WEST) ? -half : half);
+					float from = (float)start*cubeWidth - half;
+					float to = (float)(i-1)*cubeWidth + half;
+
+					if (alongX) {
+						addQuad(from, bottom, fixed, to, top, fixed, true, renderStage);
+					} else {
+						addQuad(fixed, bottom, from, fixed, top, to, false, renderStage);
+					}
+					start = -1;
+				}
+			}
+		}
+	}
+}
+
+/**
+ * Build the mesh for the grid squares in a chunk
+ * The bottoms of blocks sit on the floor and the bottom of the floor is below
+ * the camera, so neither is generated.
+ * @param vertices Baked vertices to append to, BAKED_VALS_PER_VERT values each
+ * @param indices Indices to append to
+ */
+void GreedyMesher::buildChunk(int firstRow, int firstCol, int lastRow, int lastCol, 
+	std::vector<float> &vertices, std::vector<unsigned int> &indices) {
+	this->vertices = &vertices;
+	this->indices = &indices;
+
+	addTops(LAYER_FLOOR, firstRow, firstCol, lastRow, lastCol);
+	addSides(LAYER_FLOOR, firstRow, firstCol, lastRow, lastCol);
+	addTops(LAYER_BLOCKS, firstRow, firstCol, lastRow, lastCol);
+	addSides(LAYER_BLOCKS, firstRow, firstCol, lastRow, lastCol);
+
+	this->vertices = NULL;
+	this->indices = NULL;
+}
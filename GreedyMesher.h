@@ -0,0 +1,46 @@
+/**
+ * Build the baked static world mesh for one chunk of the maze.
+ * Runs of blocks are merged into larger boxes (greedy meshing), and faces
+ * hidden by neighbouring blocks or by the floor are never generated.
+ *
+ * Positions are relative to the centre of the top left grid square,
+ * with columns along x and rows along z.
+ */
+
+#ifndef GREEDYMESHER_H
+#define GREEDYMESHER_H
+
+#include <vector>
+
+#include "MazeGrid.h"
+
+// Baked vertex layout: position (x,y,z), render stage
+#define BAKED_VALS_PER_VERT 4
+
+class GreedyMesher {
+private:
+	const MazeGrid &grid;
+	float cubeWidth;
+	int rowCount, colCount;	// squares of the grid inside the maze
+
+	std::vector<float> *vertices;
+	std::vector<unsigned int> *indices;
+
+	bool isSolid(int layer, int row, int col);
+	bool isTopVisible(int layer, int row, int col);
+
+	void addVertex(float x, float y, float z, int renderStage);
+	void addQuad(float x0, float y0, float z0, float x1, float y1, float z1, 
+		bool alongX, int renderStage);
+	void addTops(int layer, int firstRow, int firstCol, int lastRow, int lastCol);
+	void addSides(int layer, int firstRow, int firstCol, int lastRow, int lastCol);
+
+public:
+	GreedyMesher(const MazeGrid &grid, float cubeWidth);
+	GreedyMesher(const MazeGrid &grid, float cubeWidth, int rowCount, int colCount);
+
+	void buildChunk(int firstRow, int firstCol, int lastRow, int lastCol, 
+		std::vector<float> &vertices, std::vector<unsigned int> &indices);
+};
+
+#endif
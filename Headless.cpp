@@ -0,0 +1,109 @@
+#include "Headless.h"
+
+#include <cstdio>
+#include <cstring>
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+EGLDisplay headlessDisplay = EGL_NO_DISPLAY;
+EGLSurface headlessSurface = EGL_NO_SURFACE;
+EGLContext headlessContext = EGL_NO_CONTEXT;
+
+/**
+ * Find an EGL display that doesn't need a window system
+ * Prefer Mesa's surfaceless platform, otherwise use the default display
+ */
+EGLDisplay getHeadlessDisplay() {
+	const char* extensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+
+	if (extensions != NULL && strstr(extensions, "EGL_MESA_platform_surfaceless") != NULL) {
+		PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay = 
+			(PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+
+		if (getPlatformDisplay != NULL) {
+			EGLDisplay display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+			if (display != EGL_NO_DISPLAY) {
+				return display;
+			}
+		}
+	}
+
+	return eglGetDisplay(EGL_DEFAULT_DISPLAY);
+}
+
+/**
+ * Create an OpenGL 3.3 core context rendering to an offscreen pbuffer, and make it current
+ * @param width Width of the pbuffer in pixels
+ * @param height Height of the pbuffer in pixels
+ * @return true if the context was created
+ */
+bool createHeadlessContext(int width, int height) {
+	headlessDisplay = getHeadlessDisplay();
+	if (headlessDisplay == EGL_NO_DISPLAY || !eglInitialize(headlessDisplay, NULL, NULL)) {
+		fprintf(stderr, "Couldn't initialise an EGL display\n");
+		return false;
+	}
+
+	const EGLint configAttribs[] = {
+		EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+		EGL_RED_SIZE, 8,
+		EGL_GREEN_SIZE, 8,
+		EGL_BLUE_SIZE, 8,
+		EGL_DEPTH_SIZE, 24,
+		EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+		EGL_NONE
+	};
+
+	EGLConfig config;
+	EGLint configCount;
+	if (!eglChooseConfig(headlessDisplay, configAttribs, &config, 1, &configCount) || configCount < 1) {
+		fprintf(stderr, "No EGL config supports offscreen OpenGL rendering\n");
+		return false;
+	}
+
+	const EGLint pbufferAttribs[] = {
+		EGL_WIDTH, width,
+		EGL_HEIGHT, height,
+		EGL_NONE
+	};
+
+	headlessSurface = eglCreatePbufferSurface(headlessDisplay, config, pbufferAttribs);
+	if (headlessSurface == EGL_NO_SURFACE) {
+		fprintf(stderr, "Couldn't create an EGL pbuffer\n");
+		return false;
+	}
+
+	// Same context version as the window: OpenGL 3.3 core
+	eglBindAPI(EGL_OPENGL_API);
+	const EGLint contextAttribs[] = {
+		EGL_CONTEXT_MAJOR_VERSION, 3,
+		EGL_CONTEXT_MINOR_VERSION, 3,
+		EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+		EGL_NONE
+	};
+
+	headlessContext = eglCreateContext(headlessDisplay, config, EGL_NO_CONTEXT, contextAttribs);
+	if (headlessContext == EGL_NO_CONTEXT) {
+		fprintf(stderr, "Couldn't create an OpenGL 3.3 context with EGL\n");
+		return false;
+	}
+
+	return eglMakeCurrent(headlessDisplay, headlessSurface, headlessSurface, headlessContext);
+}
+
+/**
+ * Release the offscreen context created by createHeadlessContext
+ */
+void destroyHeadlessContext() {
+	if (headlessDisplay == EGL_NO_DISPLAY) {
+		return;
+	}
+
+	eglMakeCurrent(headlessDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+	eglDestroyContext(headlessDisplay, headlessContext);
+	eglDestroySurface(headlessDisplay, headlessSurface);
+	eglTerminate(headlessDisplay);
+
+	headlessDisplay = EGL_NO_DISPLAY;
+}
@@ -0,0 +1,12 @@
+/**
+ * Offscreen OpenGL context for machines without a display.
+ * Uses an EGL pbuffer, which works on Mesa's llvmpipe software renderer.
+ */
+
+#ifndef HEADLESS_H
+#define HEADLESS_H
+
+bool createHeadlessContext(int width, int height);
+void destroyHeadlessContext();
+
+#endif
@@ -1,6 +1,10 @@
 #include "Cube.h"
+#include "GreedyMesher.h"
 #include "Maze.h"
+#include "MeshFormat.h"
+#include "Profiler.h"
 #include "Sphere.hpp"
+#include "TileStore.h"
 
 #include <GL/glew.h>
 
@@ -10,96 +14,240 @@
 
 #include <GLFW/glfw3.h>
 
-#define RENDER_STAGE_FLOOR 0
-#define RENDER_STAGE_BLOCKS 1
-#define RENDER_STAGE_GOAL 2
-#define RENDER_STAGE_BALL 3
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <utility>
 
-int cubeIndicesCount;
-int sphereIndicesCount;
+// Number of grid squares along each side of a chunk of the baked static world
+#define CHUNK_SIZE 32
 
-unsigned int cubeVaoHandle;
-unsigned int sphereVaoHandle;
+// Profiler phase that times the draws of each render stage
+const int stagePhases[RENDER_STAGE_COUNT] = {
+	PROFILE_PHASE_FLOOR, PROFILE_PHASE_BLOCKS, PROFILE_PHASE_GOAL, PROFILE_PHASE_BALL, PROFILE_PHASE_WORLD
+};
 
 /**
  * Creates a new vertex array object
  * and loads in data into a vertex attribute buffer
+ * Positions are stored as half floats and indices as 16 bit values
+ * when they fit, otherwise as floats and 32 bit values.
  *
  * @param handle Pointer to VAO handle to bind when drawing this object
+ * @param buffer Set to the vertex and index buffers, to delete them with the VAO
  * @param vertices Vertices of object
- * @param vertCount Number of vertices
+ * @param vertCount Number of vertex values (vertices * valsPerVert)
  * @param valsPerVert Number of coordinate values per vertex
  * @param indices Indices of object
  * @param indCount Number of indices
+ * @param indexType Set to the type of the uploaded indices, needed to draw
  */
-void Maze::createVAO(unsigned int* handle, 
+void Maze::createVAO(unsigned int* handle, unsigned int* buffer, 
 	float* vertices, int vertCount, int valsPerVert, 
-	unsigned int* indices, int indCount)
+	unsigned int* indices, int indCount, unsigned int* indexType)
 	{
 	// Generate storage for VAO and make it current
 	glGenVertexArrays(1, handle);
 	glBindVertexArray(*handle);
 
 	// Buffer for vertices and indices
-	unsigned int buffer[2];
 	glGenBuffers(2, buffer);
 
 	// Set vertex attributes
 	glBindBuffer(GL_ARRAY_BUFFER, buffer[0]);
-	glBufferData(GL_ARRAY_BUFFER,
-		sizeof(float)*vertCount, 
-		vertices, 
-		GL_STATIC_DRAW);
 	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(0, valsPerVert, GL_FLOAT, GL_FALSE, 0, 0);
+	if (valsPerVert == 3 && fitsHalfFloat(vertices, vertCount)) {
+		std::vector<unsigned short> packedVertices;
+		packHalfFloatPositions(vertices, vertCount / 3, packedVertices);
+
+		glBufferData(GL_ARRAY_BUFFER,
+			sizeof(unsigned short)*packedVertices.size(), 
+			packedVertices.data(), 
+			GL_STATIC_DRAW);
+		glVertexAttribPointer(0, 3, GL_HALF_FLOAT, GL_FALSE, 4*sizeof(unsigned short), 0);
+	} else {
+		glBufferData(GL_ARRAY_BUFFER,
+			sizeof(float)*vertCount, 
+			vertices, 
+			GL_STATIC_DRAW);
+		glVertexAttribPointer(0, valsPerVert, GL_FLOAT, GL_FALSE, 0, 0);
+	}
 
 	// Set element attributes
+	*indexType = smallestIndexType(indices, indCount);
+	std::vector<unsigned char> packedIndices;
+	packIndices(indices, indCount, *indexType, packedIndices);
+
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffer[1]);
 	glBufferData(GL_ELEMENT_ARRAY_BUFFER,
-		sizeof(unsigned int)*indCount, 
-		indices, 
+		packedIndices.size(), 
+		packedIndices.data(), 
 		GL_STATIC_DRAW);   
 }
 
 /**
- * This helper traverses the grid and finds the x,y coordiates of blocks and the goal
- * Use these coordinates to draw blocks, 
- * instead of always traversing the grid to find blocks and goal
+ * Creates a VAO that draws the cube once per offset in a buffer
+ * The cube's vertex and index buffers are shared, and each instance of it is
+ * translated by its own offset in the vertex shader.
+ *
+ * @param handle Pointer to VAO handle to bind when drawing the instances
+ * @param offsetsBuffer Buffer of x,y,z translations
+ * @param firstOffset Byte offset in the buffer of the first instance's translation
  */
-void Maze::setupItemCoordinates() {
-	std::string mazeLine;
+void Maze::createCubeInstancesVAO(unsigned int* handle, unsigned int offsetsBuffer, long firstOffset) {
+	glGenVertexArrays(1, handle);
+	glBindVertexArray(*handle);
 
-	for (int row = 0; row < grid.size(); row++) {
-		mazeLine = grid.at(row);
+	glBindBuffer(GL_ARRAY_BUFFER, cubeBuffers[0]);
+	glEnableVertexAttribArray(0);
+	if (cubeHalfFloats) {
+		glVertexAttribPointer(0, 3, GL_HALF_FLOAT, GL_FALSE, 4*sizeof(unsigned short), 0);
+	} else {
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, 0);
+	}
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, cubeBuffers[1]);
 
-		for (int col = 0; col < grid.size(); col++) {
-			if (mazeLine[col] == '*') {
-				blocks.push_back(row);
-				blocks.push_back(col);
-			} else if (mazeLine[col] == 'X') {
-				goalX = row;
-				goalY = col;
-			}
-		}
+	glBindBuffer(GL_ARRAY_BUFFER, offsetsBuffer);
+	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 0, (void*)firstOffset);
+	glVertexAttribDivisor(1, 1);
+
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+/**
+ * Creates a VAO for the baked static world
+ * Vertices are interleaved: position and render stage
+ *
+ * @param handle Pointer to VAO handle to bind when drawing the static world
+ * @param buffers Set to the vertex and index buffers, to delete them with the VAO
+ * @param bufferSizes Set to the bytes allocated for the vertices and indices
+ * @param vertices Baked vertices, BAKED_VALS_PER_VERT values each
+ * @param indices Indices into the baked vertices
+ * @param indexType Set to the type of the uploaded indices, needed to draw
+ */
+void Maze::createBakedVAO(unsigned int* handle, unsigned int* buffer, long* bufferSizes, 
+	std::vector<float> &vertices, std::vector<unsigned int> &indices, unsigned int* indexType) {
+	glGenVertexArrays(1, handle);
+	glBindVertexArray(*handle);
+
+	glGenBuffers(2, buffer);
+	bufferSizes[0] = 0;
+	bufferSizes[1] = 0;
+
+	int stride = BAKED_VALS_PER_VERT * sizeof(float);
+
+	uploadBuffer(GL_ARRAY_BUFFER, buffer[0], &bufferSizes[0], sizeof(float)*vertices.size(), vertices.data());
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void*)0);
+	glEnableVertexAttribArray(2);
+	glVertexAttribPointer(2, 1, GL_FLOAT, GL_FALSE, stride, (void*)(3*sizeof(float)));
+
+	// Most chunks have fewer than 65536 vertices, so 16 bit indices are enough
+	*indexType = smallestIndexType(indices.data(), indices.size());
+	std::vector<unsigned char> packedIndices;
+	packIndices(indices.data(), indices.size(), *indexType, packedIndices);
+
+	uploadBuffer(GL_ELEMENT_ARRAY_BUFFER, buffer[1], &bufferSizes[1], packedIndices.size(), packedIndices.data());
+
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+/**
+ * Replace the mesh of a chunk in its existing VAO
+ * Used when the maze is reloaded, so only changed chunks are uploaded again.
+ */
+void Maze::uploadBakedMesh(Chunk &chunk, std::vector<float> &vertices, std::vector<unsigned int> &indices) {
+	// The index buffer belongs to the VAO, so bind it first
+	glBindVertexArray(chunk.vaoHandle);
+
+	uploadBuffer(GL_ARRAY_BUFFER, chunk.buffers[0], &chunk.bufferSizes[0], sizeof(float)*vertices.size(), vertices.data());
+
+	chunk.indexType = smallestIndexType(indices.data(), indices.size());
+	std::vector<unsigned char> packedIndices;
+	packIndices(indices.data(), indices.size(), chunk.indexType, packedIndices);
+	uploadBuffer(GL_ELEMENT_ARRAY_BUFFER, chunk.buffers[1], &chunk.bufferSizes[1], packedIndices.size(), packedIndices.data());
+	chunk.indicesCount = indices.size();
+
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+/**
+ * Replace the contents of a buffer, which is only reallocated if the new data doesn't fit
+ * @param target GL_ARRAY_BUFFER or GL_ELEMENT_ARRAY_BUFFER
+ * @param buffer Buffer to fill
+ * @param size Bytes allocated for the buffer, updated if it grows
+ * @param newSize Bytes of data
+ * @param data Data to upload
+ */
+void Maze::uploadBuffer(unsigned int target, unsigned int buffer, long* size, long newSize, const void* data) {
+	glBindBuffer(target, buffer);
+	if (newSize > *size) {
+		glBufferData(target, newSize, data, GL_STATIC_DRAW);
+		*size = newSize;
+	} else {
+		glBufferSubData(target, 0, newSize, data);
 	}
 }
 
+/**
+ * Delete the VAOs and buffers of a chunk of the static world
+ */
+void Maze::deleteChunk(Chunk &chunk) {
+	glDeleteVertexArrays(1, &chunk.vaoHandle);
+	glDeleteBuffers(2, chunk.buffers);
+
+	// Nothing to delete if the chunk was never drawn instanced, GL ignores 0
+	unsigned int instanceVaos[] = { chunk.floorVaoHandle, chunk.blocksVaoHandle };
+	glDeleteVertexArrays(2, instanceVaos);
+	glDeleteBuffers(1, &chunk.offsetsBuffer);
+}
+
+/**
+ * Delete every VAO and buffer the maze created
+ */
+void Maze::deleteVAOs() {
+	for (int i = 0; i < chunks.size(); i++) {
+		deleteChunk(chunks[i]);
+	}
+	chunks.clear();
+
+	unsigned int vaos[] = { cubeVaoHandle, sphereVaoHandle };
+	glDeleteVertexArrays(2, vaos);
+
+	glDeleteBuffers(2, cubeBuffers);
+	glDeleteBuffers(2, sphereBuffers);
+}
+
 /**
  * This helper sets the uniform handles and values required for the maze
+ * Each stage's program only has the uniforms its stage uses, except model which all need.
  */
 void Maze::setupUniformVars() {
-	int squareRadiusHandle = glGetUniformLocation(programID, "squareRadius");
-	int sphereRadiusHandle = glGetUniformLocation(programID, "sphereRadius");
-	renderStageUniformHandle = glGetUniformLocation(programID, "renderStage");
-	modelUniformHandle = glGetUniformLocation(programID, "model");
+	for (int stage = 0; stage < RENDER_STAGE_COUNT; stage++) {
+		glUseProgram(programIDs[stage]);
 
-	if (squareRadiusHandle == -1 || sphereRadiusHandle == -1 || 
-		renderStageUniformHandle == -1 || modelUniformHandle == -1) {
-		exit(1);
-	}
+		int squareRadiusHandle = glGetUniformLocation(programIDs[stage], "squareRadius");
+		int sphereRadiusHandle = glGetUniformLocation(programIDs[stage], "sphereRadius");
+		int cellWidthHandle = glGetUniformLocation(programIDs[stage], "cellWidth");
+		modelUniformHandles[stage] = glGetUniformLocation(programIDs[stage], "model");
 
-	glUniform1f(squareRadiusHandle, 0.4f*cubeWidth);
-	glUniform1f(sphereRadiusHandle, sphereRadius);
+		bool isSphere = (stage == RENDER_STAGE_GOAL || stage == RENDER_STAGE_BALL);
+		if (modelUniformHandles[stage] == -1 || (isSphere && sphereRadiusHandle == -1) || 
+			(!isSphere && (squareRadiusHandle == -1 || cellWidthHandle == -1))) {
+			exit(1);
+		}
+
+		if (isSphere) {
+			glUniform1f(sphereRadiusHandle, sphereRadius);
+		} else {
+			glUniform1f(squareRadiusHandle, 0.4f*cubeWidth);
+			glUniform1f(cellWidthHandle, cubeWidth);
+		}
+	}
 }
 
 /**
@@ -135,116 +283,520 @@ void Maze::setupVAOs() {
 	cubeIndicesCount = cube->indCount;
 	sphereIndicesCount = sphere->indCount;
 
-	createVAO(&cubeVaoHandle, 
+	createVAO(&cubeVaoHandle, cubeBuffers, 
 		cube->vertices, cube->vertCount, cube->valsPerVert, 
-		cube->indices, cube->indCount);
+		cube->indices, cube->indCount, &cubeIndexType);
+	cubeHalfFloats = fitsHalfFloat(cube->vertices, cube->vertCount);
 
-	createVAO(&sphereVaoHandle, 
+	createVAO(&sphereVaoHandle, sphereBuffers, 
 		sphere->vertices, sphere->vertCount, sphere->valsPerVert, 
-		sphere->indices, sphere->indCount);
+		sphere->indices, sphere->indCount, &sphereIndexType);
+
+	// Floor tiles: reduce the height of the cube and move it below the XZ plane
+	floorCubeTransform = glm::scale(glm::mat4(1.0f), glm::vec3(1.0f, 0.5f, 1.0f));
+	floorCubeTransform = glm::translate(floorCubeTransform, glm::vec3(0.0f, -0.5f*cubeWidth, 0.0f));
+
+	// Blocks: move the cube up so it sits on the XZ plane
+	blockCubeTransform = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, cubeWidth/2.0f, 0.0f));
 
 	delete cube;
 	delete sphere;
 }
 
+/**
+ * Check if the floor tile of a square can be seen at all
+ * The sides are only seen at the edge of the maze, and the top is covered
+ * when there is a block on it.
+ * @param row Row in grid
+ * @param col Column in grid
+ */
+bool Maze::isFloorDrawn(int row, int col) {
+	int lastSquare = ((tiles != NULL) ? tiles->size() : grid.size()) - 1;
+	bool edge = row + windowRow == 0 || col + windowCol == 0 || 
+		row + windowRow == lastSquare || col + windowCol == lastSquare;
+	return edge || !grid.isBlock(row, col);
+}
+
+/**
+ * Upload the offsets of a chunk's floor tiles and blocks, so each group is
+ * drawn with a single instanced draw call
+ * Done the first time the chunk is drawn by RENDER_MODE_INSTANCED, since the
+ * offsets take 12 bytes per floor tile and block, and again when a reload
+ * changes the chunk. Offsets are relative to the chunk's baked square, like its mesh.
+ */
+void Maze::setupChunkInstances(Chunk &chunk) {
+	std::vector<float> offsets;
+	chunk.floorCount = 0;
+	chunk.blocksCount = 0;
+
+	for (int pass = 0; pass < 2; pass++) {
+		for (int row = chunk.firstRow; row <= chunk.lastRow; row++) {
+			for (int col = chunk.firstCol; col <= chunk.lastCol; col++) {
+				bool drawn = (pass == 0) ? isFloorDrawn(row - windowRow, col - windowCol) : 
+					grid.isBlock(row - windowRow, col - windowCol);
+				if (!drawn) {
+					continue;
+				}
+
+				offsets.push_back((float)(col - chunk.bakedCol) * cubeWidth);
+				offsets.push_back(0.0f);
+				offsets.push_back((float)(row - chunk.bakedRow) * cubeWidth);
+				(pass == 0) ? chunk.floorCount++ : chunk.blocksCount++;
+			}
+		}
+	}
+
+	if (chunk.offsetsBuffer == 0) {
+		glGenBuffers(1, &chunk.offsetsBuffer);
+		chunk.offsetsSize = 0;
+	}
+	uploadBuffer(GL_ARRAY_BUFFER, chunk.offsetsBuffer, &chunk.offsetsSize, sizeof(float)*offsets.size(), offsets.data());
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	// The blocks start after the floor tiles, which moves if blocks were added or removed
+	glDeleteVertexArrays(1, &chunk.blocksVaoHandle);
+	createCubeInstancesVAO(&chunk.blocksVaoHandle, chunk.offsetsBuffer, 3*sizeof(float)*chunk.floorCount);
+	if (chunk.floorVaoHandle == 0) {
+		createCubeInstancesVAO(&chunk.floorVaoHandle, chunk.offsetsBuffer, 0);
+	}
+}
+
+/**
+ * Mesh part of the grid and upload it as a chunk of the static world
+ * Vertices are relative to the top left square of the grid.
+ * @param mesher Mesher of the grid
+ * @param chunk Set to the uploaded chunk, which still has to be placed
+ */
+void Maze::bakeChunk(GreedyMesher &mesher, int firstRow, int firstCol, int lastRow, int lastCol, Chunk &chunk) {
+	std::vector<float> vertices;
+	std::vector<unsigned int> indices;
+	mesher.buildChunk(firstRow, firstCol, lastRow, lastCol, vertices, indices);
+
+	chunk.firstRow = windowRow + firstRow;
+	chunk.firstCol = windowCol + firstCol;
+	chunk.lastRow = windowRow + lastRow;
+	chunk.lastCol = windowCol + lastCol;
+	chunk.bakedRow = windowRow;
+	chunk.bakedCol = windowCol;
+	chunk.indicesCount = indices.size();
+	chunk.occluded = false;
+	chunk.floorVaoHandle = 0;
+	chunk.blocksVaoHandle = 0;
+	chunk.offsetsBuffer = 0;
+	createBakedVAO(&chunk.vaoHandle, chunk.buffers, chunk.bufferSizes, vertices, indices, &chunk.indexType);
+}
+
+/**
+ * Mesh one tile of the window of a paged maze on its own, and upload it
+ * The tile doesn't depend on its neighbours in the window, so it stays
+ * correct wherever the window moves. Vertices are relative to the tile's top
+ * left square. Tiles at the bottom or right of the maze are only meshed up to
+ * its edge.
+ * @param firstRow Top row of the tile in the window
+ * @param firstCol Left column of the tile in the window
+ * @param lastRow Last row of the tile inside the maze, in the window
+ * @param lastCol Last column of the tile inside the maze, in the window
+ * @param chunk Set to the uploaded chunk, which still has to be placed
+ */
+void Maze::bakeTile(int firstRow, int firstCol, int lastRow, int lastCol, Chunk &chunk) {
+	MazeGrid tile;
+	uint64_t *words = tile.allocate(TILE_SIZE);
+	for (int i = 0; i < TILE_SIZE; i++) {
+		words[i] = grid.getRow(firstRow + i)[firstCol / 64];
+	}
+
+	GreedyMesher mesher(tile, cubeWidth, lastRow - firstRow + 1, lastCol - firstCol + 1);
+	bakeChunk(mesher, 0, 0, lastRow - firstRow, lastCol - firstCol, chunk);
+
+	chunk.firstRow += firstRow;
+	chunk.firstCol += firstCol;
+	chunk.lastRow += firstRow;
+	chunk.lastCol += firstCol;
+	chunk.bakedRow = chunk.firstRow;
+	chunk.bakedCol = chunk.firstCol;
+}
+
+/**
+ * Set where a chunk is drawn, from where it is in the maze and where the window is
+ */
+void Maze::placeChunk(Chunk &chunk) {
+	glm::vec3 topLeft = glm::vec3(startingTransform[3]);
+
+	chunk.transform = glm::translate(startingTransform, glm::vec3((float)(chunk.bakedCol - windowCol) * cubeWidth, 
+		0.0f, (float)(chunk.bakedRow - windowRow) * cubeWidth));
+
+	// Floor tiles extend half a cube below the XZ plane, blocks one cube above
+	chunk.boundsMin = topLeft + glm::vec3((float)(chunk.firstCol - windowCol) * cubeWidth - cubeWidth/2.0f, 
+		-cubeWidth/2.0f, (float)(chunk.firstRow - windowRow) * cubeWidth - cubeWidth/2.0f);
+	chunk.boundsMax = topLeft + glm::vec3((float)(chunk.lastCol - windowCol) * cubeWidth + cubeWidth/2.0f, 
+		cubeWidth, (float)(chunk.lastRow - windowRow) * cubeWidth + cubeWidth/2.0f);
+}
+
+/**
+ * This helper bakes the floor and blocks into one mesh per chunk of the grid
+ * Nothing except the ball moves, so the static world is built once here
+ * instead of being transformed every frame. Runs of blocks are merged and
+ * hidden faces are dropped by the GreedyMesher. Each chunk is a single draw 
+ * call with its own bounding box, so chunks outside the camera's view can be skipped.
+ *
+ * A paged maze has one chunk per tile, rebuilt when the window moves. Tiles
+ * that were already in the window keep their chunk. The window can run past
+ * the bottom and right of the maze, where nothing is drawn.
+ */
+void Maze::setupStaticWorld() {
+	GreedyMesher mesher(grid, cubeWidth);
+	int chunkSize = (tiles != NULL) ? TILE_SIZE : CHUNK_SIZE;
+
+	// Last square of the window inside the maze
+	int lastRowInMaze = grid.size() - 1;
+	int lastColInMaze = grid.size() - 1;
+	if (tiles != NULL) {
+		lastRowInMaze = std::min(lastRowInMaze, tiles->size() - 1 - windowRow);
+		lastColInMaze = std::min(lastColInMaze, tiles->size() - 1 - windowCol);
+	}
+
+	std::vector<Chunk> oldChunks;
+	oldChunks.swap(chunks);
+	std::vector<bool> kept(oldChunks.size(), false);
+	long meshedTriangles = 0;
+
+	for (int chunkRow = 0; chunkRow <= lastRowInMaze; chunkRow += chunkSize) {
+		for (int chunkCol = 0; chunkCol <= lastColInMaze; chunkCol += chunkSize) {
+			int lastRow = std::min(chunkRow + chunkSize - 1, lastRowInMaze);
+			int lastCol = std::min(chunkCol + chunkSize - 1, lastColInMaze);
+
+			Chunk chunk;
+			int old = 0;
+			while (old < oldChunks.size() && (oldChunks[old].firstRow != windowRow + chunkRow || 
+				oldChunks[old].firstCol != windowCol + chunkCol)) {
+				old++;
+			}
+
+			if (old < oldChunks.size()) {
+				chunk = oldChunks[old];
+				kept[old] = true;
+			} else if (tiles != NULL) {
+				bakeTile(chunkRow, chunkCol, lastRow, lastCol, chunk);
+			} else {
+				bakeChunk(mesher, chunkRow, chunkCol, lastRow, lastCol, chunk);
+			}
+			meshedTriangles += chunk.indicesCount / 3;
+
+			placeChunk(chunk);
+			chunks.push_back(chunk);
+		}
+	}
+
+	for (int i = 0; i < oldChunks.size(); i++) {
+		if (!kept[i]) {
+			deleteChunk(oldChunks[i]);
+		}
+	}
+
+	// One 12 triangle cube per floor tile and per block without greedy meshing
+	if (tiles == NULL) {
+		long cubeTriangles = ((long)grid.size() * grid.size() + grid.countBlocks()) * 12;
+		std::cout << "Static world: " << meshedTriangles << " triangles (" 
+			<< cubeTriangles << " drawn as cubes)" << std::endl;
+	}
+}
+
+/**
+ * Find where the window of a paged maze starts, so the square is in its
+ * centre tile, or as near as the edge of the maze allows
+ * @param square Row or column in the whole maze
+ * @return First row or column of the window
+ */
+int Maze::findWindowStart(int square) {
+	int windowTiles = grid.size() / TILE_SIZE;
+	int firstTile = square / TILE_SIZE - windowTiles / 2;
+	firstTile = std::max(0, std::min(firstTile, tiles->getTilesPerSide() - windowTiles));
+	return firstTile * TILE_SIZE;
+}
+
+/**
+ * Move the window of a paged maze and rebuild everything that depends on the grid
+ * Tiles that stay in the window keep their chunk of the static world.
+ * @param firstRow First row of the window, a multiple of TILE_SIZE
+ * @param firstCol First column of the window, a multiple of TILE_SIZE
+ */
+void Maze::moveWindow(int firstRow, int firstCol) {
+	windowRow = firstRow;
+	windowCol = firstCol;
+
+	delete occlusionCuller;
+	tiles->copyWindow(windowRow, windowCol, grid.size(), grid);
+	grid.buildColumns();
+
+	occlusionCuller = new OcclusionCuller(grid, cubeWidth, glm::vec3(startingTransform[3]));
+
+	setupStaticWorld();
+	updateOcclusion();
+
+	prefetchAroundWindow();
+	prefetchInView();
+}
+
+/**
+ * Ask the tile store to read the ring of tiles just outside the window, so
+ * they are ready when the window next moves
+ */
+void Maze::prefetchAroundWindow() {
+	int windowTiles = grid.size() / TILE_SIZE;
+	int firstTileRow = windowRow / TILE_SIZE - 1;
+	int firstTileCol = windowCol / TILE_SIZE - 1;
+	int lastTileRow = firstTileRow + windowTiles + 1;
+	int lastTileCol = firstTileCol + windowTiles + 1;
+
+	for (int tileRow = firstTileRow; tileRow <= lastTileRow; tileRow++) {
+		for (int tileCol = firstTileCol; tileCol <= lastTileCol; tileCol++) {
+			if (tileRow == firstTileRow || tileRow == lastTileRow || tileCol == firstTileCol || tileCol == lastTileCol) {
+				tiles->prefetch(tileRow, tileCol);
+			}
+		}
+	}
+}
+
+/**
+ * Ask the tile store to read the tiles past the window that the camera looks
+ * at, up to PAGED_PREFETCH_TILES away, so the walls seen in the distance are
+ * ready when the ball heads towards them
+ */
+void Maze::prefetchInView() {
+	glm::vec3 topLeft = glm::vec3(startingTransform[3]);
+	int windowTiles = grid.size() / TILE_SIZE;
+	int firstWindowTileRow = windowRow / TILE_SIZE;
+	int firstWindowTileCol = windowCol / TILE_SIZE;
+
+	for (int tileRow = firstWindowTileRow - PAGED_PREFETCH_TILES; 
+		tileRow < firstWindowTileRow + windowTiles + PAGED_PREFETCH_TILES; tileRow++) {
+		for (int tileCol = firstWindowTileCol - PAGED_PREFETCH_TILES; 
+			tileCol < firstWindowTileCol + windowTiles + PAGED_PREFETCH_TILES; tileCol++) {
+			bool inWindow = tileRow >= firstWindowTileRow && tileRow < firstWindowTileRow + windowTiles && 
+				tileCol >= firstWindowTileCol && tileCol < firstWindowTileCol + windowTiles;
+			if (inWindow) {
+				continue;
+			}
+
+			// Where the tile would be drawn, relative to the window
+			int firstRow = tileRow * TILE_SIZE - windowRow;
+			int firstCol = tileCol * TILE_SIZE - windowCol;
+			glm::vec3 boxMin = topLeft + glm::vec3((float)firstCol * cubeWidth - cubeWidth/2.0f, 
+				-cubeWidth/2.0f, (float)firstRow * cubeWidth - cubeWidth/2.0f);
+			glm::vec3 boxMax = topLeft + glm::vec3((float)(firstCol + TILE_SIZE - 1) * cubeWidth + cubeWidth/2.0f, 
+				cubeWidth, (float)(firstRow + TILE_SIZE - 1) * cubeWidth + cubeWidth/2.0f);
+			if (frustum.intersectsBox(boxMin, boxMax)) {
+				tiles->prefetch(tileRow, tileCol);
+			}
+		}
+	}
+}
+
 /**
  * Initialise variables required to render the maze
- * @param grid Grid of characters that specify the maze
+ * @param grid Grid of characters that specify the maze, moved into the maze
  * @param mazeWidth Width of each side of the maze
- * @param programID Loaded shader program
+ * @param programIDs Loaded shader program for each render stage
+ */
+Maze::Maze(MazeGrid &&grid, float mazeWidth, const unsigned int *programIDs):
+	grid(std::move(grid)),
+	tiles(NULL),
+	mazeWidth(mazeWidth),
+	renderMode(RENDER_MODE_BAKED),
+	chunksDrawn(0),
+	chunksCulled(0),
+	occlusionEnabled(true),
+	eye(0.0f),
+	chunksOccluded(0),
+	chunksHidden(0),
+	chunksVisible(0),
+	profiler(NULL),
+	ballX(0),
+	ballY(0),
+	drawnBallX(0),
+	drawnBallY(0),
+	windowRow(0),
+	windowCol(0) {
+
+	goalX = this->grid.getGoalRow();
+	goalY = this->grid.getGoalCol();
+
+	setup(programIDs);
+}
+
+/**
+ * Initialise variables required to render a paged maze
+ * Only the window around the start square is read now, the rest of the
+ * maze is read as the ball moves.
+ * @param tiles Opened tiled maze, which must outlive the maze
+ * @param mazeWidth Width of each side of the window
+ * @param programIDs Loaded shader program for each render stage
  */
-Maze::Maze(std::vector<std::string> grid, float mazeWidth, unsigned int programID):
-	grid(grid),
-	programID(programID),
+Maze::Maze(TileStore* tiles, float mazeWidth, const unsigned int *programIDs):
+	tiles(tiles),
+	mazeWidth(mazeWidth),
+	renderMode(RENDER_MODE_BAKED),
+	chunksDrawn(0),
+	chunksCulled(0),
+	occlusionEnabled(true),
+	eye(0.0f),
+	chunksOccluded(0),
+	chunksHidden(0),
+	chunksVisible(0),
+	profiler(NULL),
 	ballX(0),
-	ballY(0) {
+	ballY(0),
+	drawnBallX(tiles->getStartRow()),
+	drawnBallY(tiles->getStartCol()) {
+
+	goalX = tiles->getGoalRow();
+	goalY = tiles->getGoalCol();
+
+	// The window is the same size wherever it is, mazes smaller than the window fill it
+	int windowSize = std::min(PAGED_WINDOW_TILES, tiles->getTilesPerSide()) * TILE_SIZE;
+	grid.allocate(windowSize);
+	windowRow = findWindowStart(drawnBallX);
+	windowCol = findWindowStart(drawnBallY);
+	tiles->copyWindow(windowRow, windowCol, windowSize, grid);
+	grid.buildColumns();
+
+	setup(programIDs);
+	prefetchAroundWindow();
+
+	std::cout << "Paged maze: " << tiles->size() << "x" << tiles->size() << " squares, drawing "
+		<< windowSize << "x" << windowSize << " around the ball" << std::endl;
+}
 
-	// Use shader program
-	glUseProgram(programID);
+/**
+ * Build everything needed to render the grid
+ * @param programIDs Loaded shader program for each render stage
+ */
+void Maze::setup(const unsigned int *programIDs) {
+	std::copy(programIDs, programIDs + RENDER_STAGE_COUNT, this->programIDs);
 
 	// Calculate dimensions of cube, sphere and squares based on maze width and grid size
 	cubeWidth = mazeWidth/(float)grid.size();
 	sphereRadius = 0.43f*cubeWidth;
 
-	// Find x,y coordinates of blocks and goal in the grid
-	setupItemCoordinates();
-
 	// Create a transform at the top left of the maze
 	setupStartingTransform(mazeWidth);
 
+	// Tests what is hidden behind runs of blocks
+	occlusionCuller = new OcclusionCuller(grid, cubeWidth, glm::vec3(startingTransform[3]));
+
 	// Get uniform handles and set values
 	setupUniformVars();
 
 	// Create VAOs of shapes needed for the maze
 	setupVAOs();
+
+	// Merge the floor and blocks into one pre-transformed mesh
+	setupStaticWorld();
 }
 
+/**
+ * Needs the OpenGL context the maze was created in, to delete its VAOs
+ */
+Maze::~Maze() {
+	deleteVAOs();
+	delete occlusionCuller;
+}
 
 /**
- * Bind cube VAO, draw a cube that can be modified by a transformation matrix
+ * Queue a cube that can be modified by a transformation matrix
+ * @param stage Render stage, which chooses the program
  * @param transform Translate, rotate and scale cube
  */
-void Maze::drawCube(glm::mat4 transform) {
-	glBindVertexArray(cubeVaoHandle);
-
-	glUniformMatrix4fv(modelUniformHandle, 1, false, glm::value_ptr(transform));
-	glDrawElements(GL_TRIANGLES, cubeIndicesCount, GL_UNSIGNED_INT, 0);
-
-	unbindAfterDraw();
+void Maze::drawCube(int stage, glm::mat4 transform) {
+	renderQueue.add(programIDs[stage], cubeVaoHandle, modelUniformHandles[stage], 
+		transform, cubeIndicesCount, cubeIndexType, 0, stagePhases[stage]);
 }
 
 /**
- * Bind sphere VAO, draw a sphere that can be modified by a transformation matrix
+ * Queue a sphere that can be modified by a transformation matrix
+ * @param stage Render stage, which chooses the program
  * @param transform Translate, rotate and scale cube
  */
-void Maze::drawSphere(glm::mat4 transform) {
-	glBindVertexArray(sphereVaoHandle);
-
-	glUniformMatrix4fv(modelUniformHandle, 1, false, glm::value_ptr(transform));
-	glDrawElements(GL_TRIANGLES, sphereIndicesCount, GL_UNSIGNED_INT, 0);
-
-	unbindAfterDraw();
+void Maze::drawSphere(int stage, glm::mat4 transform) {
+	renderQueue.add(programIDs[stage], sphereVaoHandle, modelUniformHandles[stage], 
+		transform, sphereIndicesCount, sphereIndexType, 0, stagePhases[stage]);
 }
 
 /**
- * Render the maze floor
- * Draw one cube (with reduced height) for each grid square in the maze
+ * Queue every instance of an instanced cube VAO as a single draw call
+ * @param stage Render stage, which chooses the program
+ * @param handle VAO created by setupChunkInstances
+ * @param transform Transform shared by all instances, applied before each offset
+ * @param instanceCount Number of cubes to draw
  */
-void Maze::renderFloor() {
-	glUniform1i(renderStageUniformHandle, RENDER_STAGE_FLOOR);
+void Maze::drawCubeInstances(int stage, unsigned int handle, glm::mat4 transform, int instanceCount) {
+	renderQueue.add(programIDs[stage], handle, modelUniformHandles[stage], 
+		transform, cubeIndicesCount, cubeIndexType, instanceCount, stagePhases[stage]);
+}
 
-	glm::mat4 floorTransform;
-	for (int row = 0; row < grid.size(); row++) {
-		for (int col = 0; col < grid.size(); col++) {
-			// Move floor cube to current grid square
-			floorTransform = glm::translate(startingTransform, 
-				glm::vec3((float)row * cubeWidth, 0.0f, (float)col * cubeWidth));
-			// Reduce the height of the cube and move it below the XZ plane
-			floorTransform = glm::scale(floorTransform, glm::vec3(1.0f, 0.5f, 1.0f));
-			floorTransform = glm::translate(floorTransform, 
-				glm::vec3(0.0f, -0.5f*cubeWidth, 0.0f));
+/**
+ * Render the floor and blocks, one chunk at a time
+ * Chunks outside the view frustum or hidden behind walls are skipped,
+ * whichever way the rest are drawn.
+ */
+void Maze::renderChunks() {
+	for (int i = 0; i < chunks.size(); i++) {
+		if (!frustum.intersectsBox(chunks[i].boundsMin, chunks[i].boundsMax)) {
+			chunksCulled++;
+			continue;
+		}
+		if (chunks[i].occluded) {
+			chunksOccluded++;
+			continue;
+		}
 
-			drawCube(floorTransform);
+		if (renderMode == RENDER_MODE_BAKED) {
+			renderQueue.add(programIDs[RENDER_STAGE_BAKED], chunks[i].vaoHandle, 
+				modelUniformHandles[RENDER_STAGE_BAKED], chunks[i].transform, 
+				chunks[i].indicesCount, chunks[i].indexType, 0, stagePhases[RENDER_STAGE_BAKED]);
+		} else if (renderMode == RENDER_MODE_INSTANCED) {
+			renderChunkInstances(chunks[i]);
+		} else {
+			renderChunkCubes(chunks[i]);
 		}
+		chunksDrawn++;
 	}
 }
 
 /**
- * Render the maze blocks
- * Draw one cube for each block, placed on top of the floor
+ * Render the floor tiles and blocks of a chunk one cube at a time
  */
-void Maze::renderBlocks() {
-	glUniform1i(renderStageUniformHandle, RENDER_STAGE_BLOCKS);
- 
-	glm::mat4 blockTransform;
-	for (int i = 0; i < blocks.size(); i = i+2) {
-		// Move floor cube to current grid square and move it up so it sits on the XZ plane
-		blockTransform = glm::translate(startingTransform, 
-			glm::vec3((float)blocks.at(i+1) * cubeWidth, cubeWidth/2.0f, (float)blocks.at(i) * cubeWidth));
+void Maze::renderChunkCubes(Chunk &chunk) {
+	for (int row = chunk.firstRow - windowRow; row <= chunk.lastRow - windowRow; row++) {
+		for (int col = chunk.firstCol - windowCol; col <= chunk.lastCol - windowCol; col++) {
+			// Move cube to current grid square
+			glm::mat4 squareTransform = glm::translate(startingTransform, 
+				glm::vec3((float)col * cubeWidth, 0.0f, (float)row * cubeWidth));
 
-		drawCube(blockTransform);
+			if (isFloorDrawn(row, col)) {
+				drawCube(RENDER_STAGE_FLOOR, squareTransform * floorCubeTransform);
+			}
+			if (grid.isBlock(row, col)) {
+				drawCube(RENDER_STAGE_BLOCKS, squareTransform * blockCubeTransform);
+			}
+		}
 	}
+}
 
+/**
+ * Render the floor tiles and blocks of a chunk with one instanced draw each
+ */
+void Maze::renderChunkInstances(Chunk &chunk) {
+	if (chunk.floorVaoHandle == 0) {
+		setupChunkInstances(chunk);
+	}
+
+	if (chunk.floorCount > 0) {
+		drawCubeInstances(RENDER_STAGE_FLOOR, chunk.floorVaoHandle, chunk.transform * floorCubeTransform, chunk.floorCount);
+	}
+	if (chunk.blocksCount > 0) {
+		drawCubeInstances(RENDER_STAGE_BLOCKS, chunk.blocksVaoHandle, chunk.transform * blockCubeTransform, chunk.blocksCount);
+	}
 }
 
 /**
@@ -252,13 +804,18 @@ void Maze::renderBlocks() {
  * Draw a sphere above the floor at the goal position
  */
 void Maze::renderGoal() {
-	glUniform1i(renderStageUniformHandle, RENDER_STAGE_GOAL);
+	// A paged maze's goal may be outside the window
+	int row = goalX - windowRow;
+	int col = goalY - windowCol;
+	if (row < 0 || col < 0 || row >= grid.size() || col >= grid.size()) {
+		return;
+	}
 
 	// Move goal sphere to the goal position, move it up above the floor
 	glm::mat4 goalTransform = glm::translate(startingTransform, 
-		glm::vec3((float)goalY*cubeWidth, 0.6f*cubeWidth, (float)goalX*cubeWidth));
+		glm::vec3((float)col*cubeWidth, 0.6f*cubeWidth, (float)row*cubeWidth));
 
-	drawSphere(goalTransform);
+	drawSphere(RENDER_STAGE_GOAL, goalTransform);
 }
 
 /**
@@ -266,31 +823,374 @@ void Maze::renderGoal() {
  * Draw a sphere above the floor at the ball position
  */
 void Maze::renderBall() {
-	glUniform1i(renderStageUniformHandle, RENDER_STAGE_BALL);
-
 	// Move goal sphere to the position the player moved to, move it up above the floor
 	glm::mat4 ballTransform = glm::translate(startingTransform, 
-		glm::vec3((float)ballY*cubeWidth, 0.6f*cubeWidth, (float)ballX*cubeWidth));
+		glm::vec3((float)(drawnBallY - windowCol)*cubeWidth, 0.6f*cubeWidth, (float)(drawnBallX - windowRow)*cubeWidth));
 
-	drawSphere(ballTransform);
+	drawSphere(RENDER_STAGE_BALL, ballTransform);
 }
 
 /**
- * Unbind VAOs and buffers
+ * Draw the maze based on the maze input file.
+ * Each part of the maze queues its draws, which are then submitted sorted
+ * by program and VAO.
  */
-void Maze::unbindAfterDraw() {
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
-	glBindVertexArray(0);
+void Maze::render() {
+	chunksDrawn = 0;
+	chunksCulled = 0;
+	chunksOccluded = 0;
+	renderQueue.clear();
+
+	renderChunks();
+	renderGoal();
+	renderBall();
 
-	glFlush();
+	renderQueue.submit(profiler);
 }
 
 /**
- * Draw the maze based on the maze input file.
+ * Switch to the next way of drawing the floor and blocks
+ * Used to compare frame times between the per cube and instanced paths
  */
-void Maze::render() {
-	renderFloor();
-	renderBlocks();
-	renderGoal();
-	renderBall();
+void Maze::cycleRenderMode() {
+	renderMode = (renderMode + 1) % RENDER_MODE_COUNT;
+}
+
+/**
+ * @return Name of the current render mode, for printing
+ */
+const char* Maze::getRenderModeName() {
+	switch (renderMode) {
+		case RENDER_MODE_PER_CUBE:
+			return "per cube";
+		case RENDER_MODE_INSTANCED:
+			return "instanced";
+		case RENDER_MODE_BAKED:
+			return "baked";
+		default:
+			return "unknown";
+	}
+}
+
+/**
+ * Set the camera used to cull chunks of the static world before drawing them
+ * A paged maze also reads ahead the tiles past its window that come into view.
+ * @param projection Projection matrix
+ * @param view View matrix
+ */
+void Maze::setCamera(glm::mat4 projection, glm::mat4 view) {
+	frustum = Frustum(projection * view);
+
+	// The eye is the translation of the inverse view matrix
+	eye = glm::vec3(glm::inverse(view)[3]);
+	updateOcclusion();
+
+	if (tiles != NULL) {
+		prefetchInView();
+	}
+}
+
+/**
+ * Find the chunks hidden behind walls from the current eye position
+ * Chunks are only tested if they are in view. This is one box test per
+ * chunk, so it is cheap enough to do whenever the camera moves, and every
+ * render mode skips the same chunks.
+ */
+void Maze::updateOcclusion() {
+	if (occlusionEnabled) {
+		occlusionCuller->setEye(eye);
+	} else {
+		occlusionCuller->disable();
+	}
+
+	chunksHidden = 0;
+	chunksVisible = 0;
+	for (int i = 0; i < chunks.size(); i++) {
+		chunks[i].occluded = false;
+		if (!frustum.intersectsBox(chunks[i].boundsMin, chunks[i].boundsMax)) {
+			continue;
+		}
+		chunks[i].occluded = !occlusionCuller->isBoxVisible(chunks[i].boundsMin, chunks[i].boundsMax);
+		chunks[i].occluded ? chunksHidden++ : chunksVisible++;
+	}
+}
+
+/**
+ * Find the chunks hidden behind walls again after blocks were added or removed
+ * Rays from the eye to a chunk stay between the eye's square and the chunk's
+ * squares, so only chunks with a changed run of blocks in that rectangle are
+ * tested again. Every other run is unchanged and hides what it did before.
+ * @param changedRuns Runs through each added block, and through each removed
+ * block before it was removed
+ */
+void Maze::updateOcclusion(std::vector<BlockRun> &changedRuns) {
+	// The eye may be inside a new block, or out of a removed one
+	bool wasActive = occlusionCuller->isActive();
+	if (occlusionEnabled) {
+		occlusionCuller->setEye(eye);
+	}
+	if (occlusionCuller->isActive() != wasActive || changedRuns.size() > chunks.size()) {
+		updateOcclusion();
+		return;
+	}
+	if (!occlusionCuller->isActive()) {
+		return;
+	}
+
+	glm::vec3 topLeft = glm::vec3(startingTransform[3]);
+	int eyeRow = (int)floor((eye.z - topLeft.z) / cubeWidth + 0.5f);
+	int eyeCol = (int)floor((eye.x - topLeft.x) / cubeWidth + 0.5f);
+
+	for (int i = 0; i < chunks.size(); i++) {
+		Chunk &chunk = chunks[i];
+		if (!frustum.intersectsBox(chunk.boundsMin, chunk.boundsMax)) {
+			continue;
+		}
+
+		int firstRow = std::min(chunk.firstRow, eyeRow);
+		int firstCol = std::min(chunk.firstCol, eyeCol);
+		int lastRow = std::max(chunk.lastRow, eyeRow);
+		int lastCol = std::max(chunk.lastCol, eyeCol);
+		bool affected = false;
+		for (int j = 0; j < changedRuns.size() && !affected; j++) {
+			affected = changedRuns[j].firstRow <= lastRow && changedRuns[j].lastRow >= firstRow &&
+				changedRuns[j].firstCol <= lastCol && changedRuns[j].lastCol >= firstCol;
+		}
+		if (!affected) {
+			continue;
+		}
+
+		chunk.occluded ? chunksHidden-- : chunksVisible--;
+		chunk.occluded = !occlusionCuller->isBoxVisible(chunk.boundsMin, chunk.boundsMax);
+		chunk.occluded ? chunksHidden++ : chunksVisible++;
+	}
+}
+
+/**
+ * Turn occlusion culling on or off, to compare frame times
+ */
+void Maze::toggleOcclusionCulling() {
+	occlusionEnabled = !occlusionEnabled;
+	updateOcclusion();
+}
+
+/**
+ * @return true if things hidden behind walls are skipped
+ */
+bool Maze::isOcclusionCullingEnabled() {
+	return occlusionEnabled;
+}
+
+/**
+ * @return Number of chunks in view found hidden behind walls when the camera last moved
+ */
+int Maze::getOccludedCount() {
+	return chunksHidden;
+}
+
+/**
+ * @return Number of chunks in view tested and found visible when the camera last moved
+ */
+int Maze::getUnoccludedCount() {
+	return chunksVisible;
+}
+
+/**
+ * @return Number of static world chunks in view but hidden behind walls in the last frame
+ */
+int Maze::getChunksOccluded() {
+	return chunksOccluded;
+}
+
+/**
+ * @return Number of static world chunks drawn in the last frame
+ */
+int Maze::getChunksDrawn() {
+	return chunksDrawn;
+}
+
+/**
+ * @return Number of static world chunks outside the view in the last frame
+ */
+int Maze::getChunksCulled() {
+	return chunksCulled;
+}
+
+/**
+ * @return Number of draw calls made by the last call to render()
+ */
+int Maze::getDrawCalls() {
+	return renderQueue.getDrawCalls();
+}
+
+/**
+ * @return Number of times a shader program was bound by the last call to render()
+ */
+int Maze::getProgramBinds() {
+	return renderQueue.getProgramBinds();
+}
+
+/**
+ * Time each phase of render() with a profiler
+ * @param profiler Profiler to report to, or NULL to stop profiling
+ */
+void Maze::setProfiler(Profiler* profiler) {
+	this->profiler = profiler;
+}
+
+/**
+ * Set where the ball is drawn
+ * The game moves ballX, ballY on the simulation thread. The renderer draws the
+ * position from the latest simulation snapshot, so it never reads them directly.
+ * The window of a paged maze follows the ball when it leaves the centre tile.
+ */
+void Maze::setDrawnBallPosition(int x, int y) {
+	drawnBallX = x;
+	drawnBallY = y;
+
+	if (tiles != NULL) {
+		int firstRow = findWindowStart(drawnBallX);
+		int firstCol = findWindowStart(drawnBallY);
+		if (firstRow != windowRow || firstCol != windowCol) {
+			moveWindow(firstRow, firstCol);
+		}
+	}
+}
+
+/**
+ * Mesh and upload again the chunks of the static world that changed squares
+ * are in, or are next to, since the faces between neighbouring squares are merged.
+ * The instance offsets of the chunks holding changed squares are uploaded
+ * again too, if they were drawn instanced.
+ * @param changed Changed squares, row*size + col
+ * @return Number of chunks rebuilt
+ */
+int Maze::rebakeChunks(std::vector<int> &changed) {
+	int chunksPerSide = (grid.size() + CHUNK_SIZE - 1) / CHUNK_SIZE;
+	int offsets[5][2] = { {0, 0}, {-1, 0}, {1, 0}, {0, -1}, {0, 1} };
+
+	std::vector<int> dirty, holding;
+	for (int i = 0; i < changed.size(); i++) {
+		holding.push_back((changed[i] / grid.size() / CHUNK_SIZE) * chunksPerSide + changed[i] % grid.size() / CHUNK_SIZE);
+		for (int j = 0; j < 5; j++) {
+			int row = changed[i] / grid.size() + offsets[j][0];
+			int col = changed[i] % grid.size() + offsets[j][1];
+			if (row >= 0 && row < grid.size() && col >= 0 && col < grid.size()) {
+				dirty.push_back((row / CHUNK_SIZE) * chunksPerSide + col / CHUNK_SIZE);
+			}
+		}
+	}
+	std::sort(dirty.begin(), dirty.end());
+	dirty.erase(std::unique(dirty.begin(), dirty.end()), dirty.end());
+	std::sort(holding.begin(), holding.end());
+
+	GreedyMesher mesher(grid, cubeWidth);
+	for (int i = 0; i < dirty.size(); i++) {
+		Chunk &chunk = chunks[dirty[i]];
+
+		std::vector<float> vertices;
+		std::vector<unsigned int> indices;
+		mesher.buildChunk(chunk.firstRow, chunk.firstCol, chunk.lastRow, chunk.lastCol, vertices, indices);
+		uploadBakedMesh(chunk, vertices, indices);
+
+		// Only the chunks holding changed squares have different instances.
+		// Chunks never drawn instanced get their offsets when they first are.
+		if (chunk.floorVaoHandle != 0 && std::binary_search(holding.begin(), holding.end(), dirty[i])) {
+			setupChunkInstances(chunk);
+		}
+	}
+
+	return dirty.size();
+}
+
+/**
+ * Replace the maze with an edited copy of it, after its file changed
+ * Only the chunks of the static world around the squares whose block was
+ * added or removed are uploaded again, and only the runs through them in the
+ * slide table are filled in again. Only the chunks the changed runs of
+ * blocks could hide or uncover are tested for occlusion again. The ball
+ * stays where it is, unless it is now inside a block or outside the maze,
+ * when it goes back to the start. A maze of a different size is rebuilt
+ * from scratch. Paged mazes can't be reloaded.
+ * @param newGrid Grid of the edited maze, with its columns built
+ * @param newDistances Distance field of the edited maze, if it has one
+ */
+void Maze::reload(MazeGrid &&newGrid, DistanceField &&newDistances) {
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	// Squares whose block was added or removed
+	bool resized = newGrid.size() != grid.size();
+	std::vector<int> changed;
+	if (!resized) {
+		for (int row = 0; row < grid.size(); row++) {
+			const uint64_t *oldWords = grid.getRow(row);
+			const uint64_t *newWords = newGrid.getRow(row);
+			for (int word = 0; word < grid.getWordsPerRow(); word++) {
+				for (uint64_t bits = oldWords[word] ^ newWords[word]; bits != 0; bits &= bits - 1) {
+					changed.push_back(row * grid.size() + word*64 + __builtin_ctzll(bits));
+				}
+			}
+		}
+	}
+
+	// Runs of blocks that were split, joined, shortened or lengthened. Each
+	// covers the runs it was made from or split into.
+	std::vector<BlockRun> changedRuns;
+	for (int i = 0; i < changed.size(); i++) {
+		int row = changed[i] / grid.size();
+		int col = changed[i] % grid.size();
+		const MazeGrid &blockGrid = grid.isBlock(row, col) ? grid : newGrid;
+
+		BlockRun run;
+		run.firstRow = run.lastRow = row;
+		blockGrid.findBlockRun(blockGrid.getRow(row), col, run.firstCol, run.lastCol);
+		changedRuns.push_back(run);
+
+		run.firstCol = run.lastCol = col;
+		blockGrid.findBlockRun(blockGrid.getColumn(col), row, run.firstRow, run.lastRow);
+		changedRuns.push_back(run);
+	}
+
+	if (resized) {
+		newGrid.buildSlideTable();
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(worldMutex);
+		if (!resized) {
+			newGrid.takeSlideTable(grid);
+		}
+		grid = std::move(newGrid);
+		distances = std::move(newDistances);
+		goalX = grid.getGoalRow();
+		goalY = grid.getGoalCol();
+
+		for (int i = 0; i < changed.size(); i++) {
+			grid.updateSlideTable(changed[i] / grid.size(), changed[i] % grid.size());
+		}
+
+		if (ballX >= grid.size() || ballY >= grid.size() || grid.isBlock(ballX, ballY)) {
+			ballX = grid.getStartRow();
+			ballY = grid.getStartCol();
+			std::cout << "The ball was moved back to the start" << std::endl;
+		}
+	}
+
+	if (resized) {
+		deleteVAOs();
+		delete occlusionCuller;
+		setup(programIDs);
+		updateOcclusion();
+		std::cout << "Reloaded maze: " << grid.size() << "x" << grid.size() << ", rebuilt" << std::endl;
+		return;
+	}
+
+	int chunksRebuilt = rebakeChunks(changed);
+
+	// Added or removed blocks hide different things
+	updateOcclusion(changedRuns);
+
+	std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+	std::cout << "Reloaded maze: " << changed.size() << " squares changed, " << chunksRebuilt 
+		<< " chunks rebuilt in " << elapsed.count() << " ms" << std::endl;
 }
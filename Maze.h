@@ -1,51 +1,191 @@
 /**
  * Draw the maze by scaling and moving cubes and spheres.
  * The centre of the maze is at (0,0,0).
+ *
+ * A maze paged in from a tiled file (see TileStore.h) only holds a window of
+ * PAGED_WINDOW_TILES x PAGED_WINDOW_TILES tiles around the ball, which fills
+ * the space a whole maze would. The window moves when the ball leaves its
+ * centre tile.
 */
 
 #ifndef MAZE_H
 #define MAZE_H
 
+#include <mutex>
 #include <string>
 #include <vector>
 
+#include "DistanceField.h"
+#include "Frustum.h"
+#include "MazeGrid.h"
+#include "OcclusionCuller.h"
+#include "RenderQueue.h"
+
 #include "glm/glm.hpp"
 
+// Ways of submitting the floor and blocks to OpenGL
+#define RENDER_MODE_PER_CUBE 0
+#define RENDER_MODE_INSTANCED 1
+#define RENDER_MODE_BAKED 2
+#define RENDER_MODE_COUNT 3
+
+// Which part of the maze is being rendered. The shaders are compiled once per
+// stage with RENDER_STAGE defined, giving one program per stage.
+#define RENDER_STAGE_FLOOR 0
+#define RENDER_STAGE_BLOCKS 1
+#define RENDER_STAGE_GOAL 2
+#define RENDER_STAGE_BALL 3
+// Floor or blocks is read from each vertex of the baked static world
+#define RENDER_STAGE_BAKED 4
+#define RENDER_STAGE_COUNT 5
+
+// Tiles along each side of the window drawn from a paged maze
+#define PAGED_WINDOW_TILES 3
+// Tiles past the window read ahead when the camera looks at them
+#define PAGED_PREFETCH_TILES 4
+
+class GreedyMesher;
+class Profiler;
+class TileStore;
+
 class Maze {
 private:
-	std::vector<int> blocks;
+	// Part of the baked static world, drawn with one call if it is in view
+	struct Chunk {
+		unsigned int vaoHandle;
+		unsigned int buffers[2];	// vertices and indices, deleted with the VAO
+		long bufferSizes[2];	// bytes allocated, so a smaller mesh can reuse them
+		int indicesCount;
+		unsigned int indexType;
+		int firstRow, firstCol, lastRow, lastCol;	// squares covered, in the whole maze
+		int bakedRow, bakedCol;	// square the vertices are relative to, in the whole maze
+		glm::mat4 transform;
+		glm::vec3 boundsMin, boundsMax;
+		bool occluded;	// hidden behind walls from the current eye
+		// Floor tiles then blocks as cube instances, relative to the baked square.
+		// Only built the first time the chunk is drawn by RENDER_MODE_INSTANCED.
+		unsigned int floorVaoHandle, blocksVaoHandle, offsetsBuffer;
+		long offsetsSize;
+		int floorCount, blocksCount;
+	};
+
+	std::vector<Chunk> chunks;
+
+	// Squares covered by a run of blocks along a row or column
+	struct BlockRun {
+		int firstRow, firstCol, lastRow, lastCol;
+	};
+
+	// Cube and sphere. Chunks drawn by RENDER_MODE_INSTANCED share the cube's buffers.
+	unsigned int cubeVaoHandle, sphereVaoHandle;
+	unsigned int cubeBuffers[2], sphereBuffers[2];
+	int cubeIndicesCount, sphereIndicesCount;
+	unsigned int cubeIndexType, sphereIndexType;
+	bool cubeHalfFloats;	// the cube's positions were packed as half floats
 
-	float cubeWidth, sphereRadius;
+	float mazeWidth, cubeWidth, sphereRadius;
 	glm::mat4 startingTransform;
+	// Scale and move a cube centred on a square to a floor tile or block
+	glm::mat4 floorCubeTransform, blockCubeTransform;
+
+	int renderMode;
+
+	Frustum frustum;
+	int chunksDrawn, chunksCulled;
+
+	// Chunks hidden behind walls are not drawn, whatever the render mode
+	OcclusionCuller* occlusionCuller;
+	bool occlusionEnabled;
+	glm::vec3 eye;
+	int chunksOccluded;
+	// Chunks in view found hidden and visible when the eye last moved
+	int chunksHidden, chunksVisible;
+
+	// Draws of the current frame, submitted sorted by program and VAO
+	RenderQueue renderQueue;
+
+	Profiler* profiler;
+
+	// Ball position used by render(), from the latest simulation snapshot
+	int drawnBallX, drawnBallY;
+
+	// First square of the window held in grid, (0,0) unless the maze is paged
+	int windowRow, windowCol;
 
-	unsigned int programID;
-	int modelUniformHandle, renderStageUniformHandle;
+	unsigned int programIDs[RENDER_STAGE_COUNT];
+	int modelUniformHandles[RENDER_STAGE_COUNT];
 
-	void createVAO(unsigned int* handle, 
+	void createVAO(unsigned int* handle, unsigned int* buffers, 
 		float* vertices, int vertCount, int valsPerVert, 
-		unsigned int* indices, int indCount);
+		unsigned int* indices, int indCount, unsigned int* indexType);
+	void createCubeInstancesVAO(unsigned int* handle, unsigned int offsetsBuffer, long firstOffset);
+	void createBakedVAO(unsigned int* handle, unsigned int* buffers, long* bufferSizes, 
+		std::vector<float> &vertices, std::vector<unsigned int> &indices, unsigned int* indexType);
+	void uploadBakedMesh(Chunk &chunk, std::vector<float> &vertices, std::vector<unsigned int> &indices);
+	void uploadBuffer(unsigned int target, unsigned int buffer, long* size, long newSize, const void* data);
+	void deleteChunk(Chunk &chunk);
+	void deleteVAOs();
 
 	// render the maze
-	void drawCube(glm::mat4 transform);
-	void drawSphere(glm::mat4 transform);
-	void renderFloor();
-	void renderBlocks();
+	void drawCube(int stage, glm::mat4 transform);
+	void drawSphere(int stage, glm::mat4 transform);
+	void drawCubeInstances(int stage, unsigned int handle, glm::mat4 transform, int instanceCount);
+	void renderChunks();
+	void renderChunkCubes(Chunk &chunk);
+	void renderChunkInstances(Chunk &chunk);
 	void renderGoal();
 	void renderBall();
-	void unbindAfterDraw();
 
 	// helpers
-	void setupItemCoordinates();
+	void setup(const unsigned int *programIDs);
 	void setupStartingTransform(float mazeWidth);
 	void setupUniformVars();
 	void setupVAOs();
+	void setupChunkInstances(Chunk &chunk);
+	bool isFloorDrawn(int row, int col);
+	void setupStaticWorld();
+	void bakeChunk(GreedyMesher &mesher, int firstRow, int firstCol, int lastRow, int lastCol, Chunk &chunk);
+	void bakeTile(int firstRow, int firstCol, int lastRow, int lastCol, Chunk &chunk);
+	void placeChunk(Chunk &chunk);
+	int findWindowStart(int square);
+	void moveWindow(int firstRow, int firstCol);
+	void prefetchAroundWindow();
+	void prefetchInView();
+	void updateOcclusion();
+	void updateOcclusion(std::vector<BlockRun> &changedRuns);
+	int rebakeChunks(std::vector<int> &changed);
 
 public:
+	// Squares in the whole maze, even when it is paged
 	int ballX, ballY, goalX, goalY;
-	std::vector<std::string> grid;
+	// The whole maze, or only the window around the ball if it is paged
+	MazeGrid grid;
+	// Moves from each square to the goal, not built for paged or very big mazes
+	DistanceField distances;
+	// Held while the game uses the ball, goal, grid or distances, so reload() can replace them
+	std::mutex worldMutex;
+	// Where a paged maze is read from, NULL otherwise
+	TileStore* tiles;
 
-	Maze(std::vector<std::string> grid, float mazeWidth, unsigned int programID);
+	Maze(MazeGrid &&grid, float mazeWidth, const unsigned int *programIDs);
+	Maze(TileStore* tiles, float mazeWidth, const unsigned int *programIDs);
+	~Maze();
 	void render();
+	void setCamera(glm::mat4 projection, glm::mat4 view);
+	void setProfiler(Profiler* profiler);
+	void setDrawnBallPosition(int x, int y);
+	void reload(MazeGrid &&newGrid, DistanceField &&newDistances);
+	void cycleRenderMode();
+	const char* getRenderModeName();
+	int getChunksDrawn();
+	int getChunksCulled();
+	int getChunksOccluded();
+	void toggleOcclusionCulling();
+	bool isOcclusionCullingEnabled();
+	int getOccludedCount();
+	int getUnoccludedCount();
+	int getDrawCalls();
+	int getProgramBinds();
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,222 @@
+#include "MazeBinary.h"
+#include "MazeLoader.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+static_assert(sizeof(MazeBinaryHeader) == 56, "binary maze header must have no padding");
+
+// Constants from xxHash, used to mix each word into the checksum
+#define CHECKSUM_PRIME_1 0x9e3779b185ebca87ull
+#define CHECKSUM_PRIME_2 0xc2b2ae3d27d4eb4full
+
+uint64_t checksumWord(uint64_t checksum, uint64_t word) {
+	checksum ^= word * CHECKSUM_PRIME_2;
+	checksum = (checksum << 31) | (checksum >> 33);
+	return checksum * CHECKSUM_PRIME_1;
+}
+
+/**
+ * Checksum the header, up to the checksum itself, and the bitmap
+ * @param header Header, which is a whole number of words
+ * @param rows Bitmap
+ * @param wordCount Number of words in the bitmap
+ */
+uint64_t mazeChecksum(const MazeBinaryHeader &header, const uint64_t *rows, size_t wordCount) {
+	uint64_t words[offsetof(MazeBinaryHeader, checksum) / 8];
+	memcpy(words, &header, sizeof(words));
+
+	uint64_t checksum = MAZE_BINARY_VERSION;
+	for (size_t i = 0; i < sizeof(words) / 8; i++) {
+		checksum = checksumWord(checksum, words[i]);
+	}
+	for (size_t i = 0; i < wordCount; i++) {
+		checksum = checksumWord(checksum, rows[i]);
+	}
+	return checksum;
+}
+
+/**
+ * @return true if the data starts with the binary maze magic number
+ */
+bool isMazeBinary(const void *data, size_t length) {
+	return length >= MAZE_BINARY_MAGIC_SIZE && memcmp(data, MAZE_BINARY_MAGIC, MAZE_BINARY_MAGIC_SIZE) == 0;
+}
+
+/**
+ * Check a binary maze and use its bitmap as the grid's walls
+ * @param data Memory mapped file, starting with the magic number. If the maze
+ *	is loaded the grid takes over the mapping and unmaps it when destroyed.
+ * @param length Length of the mapping
+ * @param path Maze file, for error messages
+ * @param grid Grid to load into, left unchanged if loading fails
+ * @param error Set to a message if loading fails
+ * @return true if the maze was loaded
+ */
+bool loadMazeBinary(void *data, size_t length, const char *path, MazeGrid &grid, std::string &error) {
+	char message[128];
+
+	MazeBinaryHeader header;
+	if (length < sizeof(header)) {
+		setMazeError(error, path, 0, 0, "binary maze header is truncated");
+		return false;
+	}
+	memcpy(&header, data, sizeof(header));
+
+	if (header.version != MAZE_BINARY_VERSION) {
+		snprintf(message, sizeof(message), "binary maze version %u isn't supported, expected %d",
+			header.version, MAZE_BINARY_VERSION);
+		setMazeError(error, path, 0, 0, message);
+		return false;
+	}
+	if (header.headerSize != sizeof(header) || header.reserved != 0) {
+		setMazeError(error, path, 0, 0, "binary maze header is invalid");
+		return false;
+	}
+	if (header.width != header.height) {
+		setMazeError(error, path, 0, 0, "binary maze isn't square");
+		return false;
+	}
+	if (header.width < 2 || header.width > MAZE_MAX_SIZE) {
+		snprintf(message, sizeof(message), "maze size must be from 2 to %d", MAZE_MAX_SIZE);
+		setMazeError(error, path, 0, 0, message);
+		return false;
+	}
+
+	int size = header.width;
+	size_t wordsPerRow = (size + 63) / 64;
+	size_t wordCount = wordsPerRow * size;
+	if (header.wordsPerRow != wordsPerRow) {
+		setMazeError(error, path, 0, 0, "binary maze row length doesn't match its size");
+		return false;
+	}
+	if (length != sizeof(header) + wordCount * 8) {
+		snprintf(message, sizeof(message), "binary maze is %zu bytes, expected %zu",
+			length, sizeof(header) + wordCount * 8);
+		setMazeError(error, path, 0, 0, message);
+		return false;
+	}
+	if (header.goalRow >= (uint32_t)size || header.goalCol >= (uint32_t)size ||
+		header.startRow >= (uint32_t)size || header.startCol >= (uint32_t)size) {
+		setMazeError(error, path, 0, 0, "goal or start is outside the maze");
+		return false;
+	}
+
+	const uint64_t *rows = (const uint64_t *)((const char *)data + sizeof(header));
+	if (mazeChecksum(header, rows, wordCount) != header.checksum) {
+		setMazeError(error, path, 0, 0, "checksum doesn't match, the file is damaged");
+		return false;
+	}
+
+	const uint64_t *goalRow = rows + header.goalRow * wordsPerRow;
+	const uint64_t *startRow = rows + header.startRow * wordsPerRow;
+	if ((goalRow[header.goalCol / 64] >> (header.goalCol % 64)) & 1) {
+		setMazeError(error, path, 0, 0, "goal is a block");
+		return false;
+	}
+	if ((startRow[header.startCol / 64] >> (header.startCol % 64)) & 1) {
+		setMazeError(error, path, 0, 0, "start is a block");
+		return false;
+	}
+
+	// The last word of each row must be padded with 0
+	uint64_t padding = (size % 64 == 0) ? 0 : ~0ull << (size % 64);
+	for (int row = 0; row < size; row++) {
+		if (rows[row * wordsPerRow + wordsPerRow - 1] & padding) {
+			snprintf(message, sizeof(message), "row %d has blocks past the edge of the maze", row + 1);
+			setMazeError(error, path, 0, 0, message);
+			return false;
+		}
+	}
+
+	grid.adoptMapping(data, length, rows, size);
+	grid.setGoal(header.goalRow, header.goalCol);
+	grid.setStart(header.startRow, header.startCol);
+
+	return true;
+}
+
+/**
+ * Write a grid in the binary format
+ * @param path File to write
+ * @param grid Grid to write
+ * @param error Set to a message if writing fails
+ * @return true if the file was written
+ */
+bool writeMazeBinary(const char *path, const MazeGrid &grid, std::string &error) {
+	int size = grid.size();
+
+	MazeBinaryHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, MAZE_BINARY_MAGIC, MAZE_BINARY_MAGIC_SIZE);
+	header.version = MAZE_BINARY_VERSION;
+	header.headerSize = sizeof(header);
+	header.width = size;
+	header.height = size;
+	header.goalRow = grid.getGoalRow();
+	header.goalCol = grid.getGoalCol();
+	header.startRow = grid.getStartRow();
+	header.startCol = grid.getStartCol();
+	header.wordsPerRow = (size + 63) / 64;
+
+	// The grid's rows are already in the file's layout
+	const uint64_t *rows = grid.getRow(0);
+	size_t wordCount = (size_t)header.wordsPerRow * size;
+	header.checksum = mazeChecksum(header, rows, wordCount);
+
+	FILE *file = fopen(path, "wb");
+	if (file == NULL) {
+		setMazeError(error, path, 0, 0, strerror(errno));
+		return false;
+	}
+	bool ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+		fwrite(rows, sizeof(uint64_t), wordCount, file) == wordCount;
+	if (fclose(file) != 0 || !ok) {
+		setMazeError(error, path, 0, 0, "couldn't write the whole file");
+		return false;
+	}
+	return true;
+}
+
+/**
+ * Write a grid in the text format
+ * Text files always start in the top left square, so other starts can't be written.
+ * @param path File to write
+ * @param grid Grid to write
+ * @param error Set to a message if writing fails
+ * @return true if the file was written
+ */
+bool writeMazeText(const char *path, const MazeGrid &grid, std::string &error) {
+	if (grid.getStartRow() != 0 || grid.getStartCol() != 0) {
+		setMazeError(error, path, 0, 0, "the text format can only start in the top left square");
+		return false;
+	}
+
+	FILE *file = fopen(path, "wb");
+	if (file == NULL) {
+		setMazeError(error, path, 0, 0, strerror(errno));
+		return false;
+	}
+
+	int size = grid.size();
+	std::vector<char> line(size + 1);
+	line[size] = '\n';
+
+	bool ok = fprintf(file, "%d\n", size) > 0;
+	for (int row = 0; row < size && ok; row++) {
+		for (int col = 0; col < size; col++) {
+			line[col] = grid.isBlock(row, col) ? '*' : ' ';
+		}
+		if (row == grid.getGoalRow()) {
+			line[grid.getGoalCol()] = 'X';
+		}
+		ok = fwrite(line.data(), 1, line.size(), file) == line.size();
+	}
+	if (fclose(file) != 0 || !ok) {
+		setMazeError(error, path, 0, 0, "couldn't write the whole file");
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,48 @@
+/**
+ * Binary maze format.
+ * A fixed size header is followed by the walls as a bitmap, one bit per
+ * square. Each row starts on a 64 bit word and is padded to a whole number
+ * of words, with column c in bit (c % 64) of word (c / 64), so the rows can
+ * be used as 64 bit words straight from a memory mapped file. A set bit is
+ * a block. Padding bits must be 0.
+ *
+ * All values are little endian. The checksum covers the header up to the
+ * checksum and the whole bitmap, so a truncated or damaged file is rejected.
+ */
+
+#ifndef MAZEBINARY_H
+#define MAZEBINARY_H
+
+#include <cstddef>
+#include <stdint.h>
+#include <string>
+
+#include "MazeGrid.h"
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "The binary maze format is read in place, which needs a little endian machine"
+#endif
+
+#define MAZE_BINARY_MAGIC "MAZEBIN\x1a"
+#define MAZE_BINARY_MAGIC_SIZE 8
+#define MAZE_BINARY_VERSION 1
+
+struct MazeBinaryHeader {
+	char magic[MAZE_BINARY_MAGIC_SIZE];
+	uint32_t version;
+	uint32_t headerSize;	// bytes before the bitmap
+	uint32_t width, height;	// mazes are square for now, so these are equal
+	uint32_t goalRow, goalCol;
+	uint32_t startRow, startCol;
+	uint32_t wordsPerRow;
+	uint32_t reserved;		// 0
+	uint64_t checksum;
+};
+
+uint64_t checksumWord(uint64_t checksum, uint64_t word);
+bool isMazeBinary(const void *data, size_t length);
+bool loadMazeBinary(void *data, size_t length, const char *path, MazeGrid &grid, std::string &error);
+bool writeMazeBinary(const char *path, const MazeGrid &grid, std::string &error);
+bool writeMazeText(const char *path, const MazeGrid &grid, std::string &error);
+
+#endif
@@ -0,0 +1,474 @@
+#include "Direction.h"
+#include "MazeGrid.h"
+
+#include <algorithm>
+#include <cstring>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <sys/mman.h>
+
+MazeGrid::MazeGrid():
+	gridSize(0),
+	wordsPerRow(0),
+	rows(NULL),
+	columns(NULL),
+	stops(NULL),
+	goalRow(0),
+	goalCol(0),
+	startRow(0),
+	startCol(0),
+	ownedRows(NULL),
+	mapping(NULL),
+	mappingLength(0) {
+}
+
+MazeGrid::~MazeGrid() {
+	release();
+}
+
+/**
+ * Take over another grid's walls, leaving it empty
+ */
+MazeGrid::MazeGrid(MazeGrid &&other):
+	gridSize(0),
+	wordsPerRow(0),
+	rows(NULL),
+	columns(NULL),
+	stops(NULL),
+	goalRow(0),
+	goalCol(0),
+	startRow(0),
+	startCol(0),
+	ownedRows(NULL),
+	mapping(NULL),
+	mappingLength(0) {
+
+	*this = std::move(other);
+}
+
+MazeGrid &MazeGrid::operator=(MazeGrid &&other) {
+	if (this != &other) {
+		release();
+
+		gridSize = other.gridSize;
+		wordsPerRow = other.wordsPerRow;
+		rows = other.rows;
+		columns = other.columns;
+		stops = other.stops;
+		goalRow = other.goalRow;
+		goalCol = other.goalCol;
+		startRow = other.startRow;
+		startCol = other.startCol;
+		ownedRows = other.ownedRows;
+		mapping = other.mapping;
+		mappingLength = other.mappingLength;
+
+		// Leave the other grid empty, without releasing what it gave us
+		other.ownedRows = NULL;
+		other.columns = NULL;
+		other.stops = NULL;
+		other.mapping = NULL;
+		other.release();
+	}
+	return *this;
+}
+
+void MazeGrid::release() {
+	delete[] ownedRows;
+	delete[] columns;
+	delete[] stops;
+	if (mapping != NULL) {
+		munmap(mapping, mappingLength);
+	}
+
+	gridSize = 0;
+	wordsPerRow = 0;
+	rows = NULL;
+	columns = NULL;
+	stops = NULL;
+	goalRow = 0;
+	goalCol = 0;
+	startRow = 0;
+	startCol = 0;
+	ownedRows = NULL;
+	mapping = NULL;
+	mappingLength = 0;
+}
+
+/**
+ * Replace the walls with an empty grid owned by this grid
+ * The goal and start are reset to the top left square.
+ * @param size Number of rows and columns
+ * @return Words to set the walls in, size*getWordsPerRow() of them, all 0
+ */
+uint64_t *MazeGrid::allocate(int size) {
+	release();
+
+	wordsPerRow = (size + 63) / 64;
+	ownedRows = new uint64_t[(long)size * wordsPerRow]();
+	rows = ownedRows;
+	gridSize = size;
+	return ownedRows;
+}
+
+/**
+ * Replace the walls with rows inside a memory mapped file
+ * The grid unmaps the file when it is destroyed. The goal and start are
+ * reset to the top left square.
+ * @param mapping Start of the mapping, from mmap()
+ * @param length Length of the mapping
+ * @param rows First word of the first row, in the layout described in MazeGrid.h
+ * @param size Number of rows and columns
+ */
+void MazeGrid::adoptMapping(void *mapping, size_t length, const uint64_t *rows, int size) {
+	release();
+
+	this->mapping = mapping;
+	mappingLength = length;
+	this->rows = rows;
+	gridSize = size;
+	wordsPerRow = (size + 63) / 64;
+}
+
+/**
+ * Copy the walls out of a memory mapped file into words owned by the grid,
+ * so the file can be rewritten while the grid is in use
+ * Does nothing if the grid already owns its walls.
+ */
+void MazeGrid::detach() {
+	if (mapping == NULL) {
+		return;
+	}
+
+	ownedRows = new uint64_t[(long)gridSize * wordsPerRow];
+	memcpy(ownedRows, rows, sizeof(uint64_t) * gridSize * wordsPerRow);
+	rows = ownedRows;
+
+	munmap(mapping, mappingLength);
+	mapping = NULL;
+	mappingLength = 0;
+}
+
+/**
+ * Transpose a 64x64 block of bits in place, so bit c of word r moves to bit r of word c
+ * Swaps 32x32 blocks, then 16x16 blocks within them, and so on down to single bits.
+ * @param block 64 words
+ */
+void transposeBlock(uint64_t *block) {
+	uint64_t mask = 0x00000000ffffffffull;
+	for (int width = 32; width != 0; width >>= 1, mask ^= mask << width) {
+		for (int first = 0; first < 64; first += 2*width) {
+			for (int k = first; k < first + width; k++) {
+				uint64_t swap = ((block[k] >> width) ^ block[k + width]) & mask;
+				block[k] ^= swap << width;
+				block[k + width] ^= swap;
+			}
+		}
+	}
+}
+
+/**
+ * Build the transposed copy of the walls, used to slide along columns
+ * Call again if the walls change.
+ */
+void MazeGrid::buildColumns() {
+	delete[] columns;
+	columns = new uint64_t[(long)gridSize * wordsPerRow];
+
+	uint64_t block[64];
+	for (int colWord = 0; colWord < wordsPerRow; colWord++) {
+		for (int rowWord = 0; rowWord < wordsPerRow; rowWord++) {
+			// Rows past the edge of the maze are empty
+			for (int i = 0; i < 64; i++) {
+				int row = rowWord*64 + i;
+				block[i] = row < gridSize ? getRow(row)[colWord] : 0;
+			}
+
+			transposeBlock(block);
+
+			for (int i = 0; i < 64; i++) {
+				int col = colWord*64 + i;
+				if (col < gridSize) {
+					columns[(long)col * wordsPerRow + rowWord] = block[i];
+				}
+			}
+		}
+	}
+}
+
+/**
+ * Find the first block at or after a square
+ * @param words Row or column of walls
+ * @param from First square to look at
+ * @return Index of the block, or the size of the maze if there is none
+ */
+int MazeGrid::nextBlock(const uint64_t *words, int from) const {
+	if (from >= gridSize) {
+		return gridSize;
+	}
+
+	int word = from >> 6;
+	uint64_t blocks = words[word] & (~0ull << (from & 63));
+	while (blocks == 0) {
+		if (++word == wordsPerRow) {
+			return gridSize;
+		}
+		blocks = words[word];
+	}
+	return word*64 + __builtin_ctzll(blocks);
+}
+
+/**
+ * Find the last block at or before a square
+ * @param words Row or column of walls
+ * @param from First square to look at
+ * @return Index of the block, or -1 if there is none
+ */
+int MazeGrid::previousBlock(const uint64_t *words, int from) const {
+	if (from < 0) {
+		return -1;
+	}
+
+	int word = from >> 6;
+	uint64_t blocks = words[word] & (~0ull >> (63 - (from & 63)));
+	while (blocks == 0) {
+		if (--word < 0) {
+			return -1;
+		}
+		blocks = words[word];
+	}
+	return word*64 + 63 - __builtin_clzll(blocks);
+}
+
+/**
+ * Find the run of neighbouring blocks through a block
+ * @param words Row or column of walls
+ * @param from Square that is a block
+ * @param first Set to the first block of the run
+ * @param last Set to the last block of the run
+ */
+void MazeGrid::findBlockRun(const uint64_t *words, int from, int &first, int &last) const {
+	int word = from >> 6;
+	uint64_t free = ~words[word] & (~0ull >> (63 - (from & 63)));
+	while (free == 0 && --word >= 0) {
+		free = ~words[word];
+	}
+	first = (word < 0) ? 0 : word*64 + 63 - __builtin_clzll(free) + 1;
+
+	// Bits past the edge of the maze are free
+	word = from >> 6;
+	free = ~words[word] & (~0ull << (from & 63));
+	while (free == 0 && ++word < wordsPerRow) {
+		free = ~words[word];
+	}
+	last = (word == wordsPerRow) ? gridSize - 1 : std::min(word*64 + __builtin_ctzll(free) - 1, gridSize - 1);
+}
+
+/**
+ * Fill in the east and west stops of part of a row
+ * Blocks stop where they are, they are never slid from.
+ * @param row Row to fill
+ * @param firstCol First column to fill
+ * @param lastCol Last column to fill
+ */
+void MazeGrid::fillRowStops(int row, int firstCol, int lastCol) {
+	const uint64_t *words = getRow(row);
+	uint16_t *rowStops = stops + (long)row * gridSize * DIRECTION_COUNT;
+
+	int col = firstCol;
+	while (col <= lastCol) {
+		int block = nextBlock(words, col);
+		if (block == col) {
+			rowStops[col*DIRECTION_COUNT + EAST] = col;
+			rowStops[col*DIRECTION_COUNT + WEST] = col;
+			col++;
+			continue;
+		}
+
+		// Every square of a run stops at the same two ends
+		int first = previousBlock(words, col - 1) + 1;
+		int end = std::min(block - 1, lastCol);
+		for (; col <= end; col++) {
+			rowStops[col*DIRECTION_COUNT + EAST] = block - 1;
+			rowStops[col*DIRECTION_COUNT + WEST] = first;
+		}
+	}
+}
+
+/**
+ * Fill in the north and south stops of part of a column
+ * @param col Column to fill
+ * @param firstRow First row to fill
+ * @param lastRow Last row to fill
+ */
+void MazeGrid::fillColumnStops(int col, int firstRow, int lastRow) {
+	const uint64_t *words = getColumn(col);
+	uint16_t *colStops = stops + (long)col * DIRECTION_COUNT;
+	long rowStride = (long)gridSize * DIRECTION_COUNT;
+
+	int row = firstRow;
+	while (row <= lastRow) {
+		int block = nextBlock(words, row);
+		if (block == row) {
+			colStops[row*rowStride + SOUTH] = row;
+			colStops[row*rowStride + NORTH] = row;
+			row++;
+			continue;
+		}
+
+		int first = previousBlock(words, row - 1) + 1;
+		int end = std::min(block - 1, lastRow);
+		for (; row <= end; row++) {
+			colStops[row*rowStride + SOUTH] = block - 1;
+			colStops[row*rowStride + NORTH] = first;
+		}
+	}
+}
+
+/**
+ * Build the table of where every slide stops, so slide() is one lookup
+ * Needs buildColumns(). Does nothing for mazes bigger than
+ * SLIDE_TABLE_MAX_SIZE, which keep sliding with bit scans. Each thread
+ * fills a band of rows and the same band of columns, so threads write to
+ * different parts of each row of the table.
+ * Call again if the walls change, or updateSlideTable() for a few squares.
+ */
+void MazeGrid::buildSlideTable() {
+	delete[] stops;
+	stops = NULL;
+	if (gridSize > SLIDE_TABLE_MAX_SIZE) {
+		return;
+	}
+	stops = new uint16_t[(long)gridSize * gridSize * DIRECTION_COUNT];
+
+	int threadCount = std::max(1, std::min((int)std::thread::hardware_concurrency(), gridSize / 64));
+	std::vector<std::thread> threads;
+	for (int i = 0; i < threadCount; i++) {
+		int first = (long)gridSize * i / threadCount;
+		int last = (long)gridSize * (i + 1) / threadCount - 1;
+		threads.push_back(std::thread([this, first, last]() {
+			for (int line = first; line <= last; line++) {
+				fillRowStops(line, 0, gridSize - 1);
+				fillColumnStops(line, 0, gridSize - 1);
+			}
+		}));
+	}
+	for (int i = 0; i < threadCount; i++) {
+		threads[i].join();
+	}
+}
+
+/**
+ * Take the slide table of another grid the same size, which is left
+ * without one, so it can be brought up to date with updateSlideTable()
+ * instead of building a new one
+ */
+void MazeGrid::takeSlideTable(MazeGrid &other) {
+	delete[] stops;
+	stops = other.stops;
+	other.stops = NULL;
+}
+
+/**
+ * Bring the slide table up to date after a square changed between free and block
+ * Only the runs along the square's row and column that end at, or
+ * include, the square are filled in again. Needs the columns rebuilt first.
+ */
+void MazeGrid::updateSlideTable(int row, int col) {
+	if (stops == NULL) {
+		return;
+	}
+
+	const uint64_t *words = getRow(row);
+	fillRowStops(row, previousBlock(words, col - 1) + 1, std::min(nextBlock(words, col + 1), gridSize - 1));
+
+	words = getColumn(col);
+	fillColumnStops(col, previousBlock(words, row - 1) + 1, std::min(nextBlock(words, row + 1), gridSize - 1));
+}
+
+/**
+ * Slide from a square until the next square is a block or the edge of the maze
+ * Needs buildColumns() for NORTH and SOUTH, or the slide table.
+ * @param direction NORTH, EAST, SOUTH or WEST
+ * @param row Row to start from, set to the row the slide stops in
+ * @param col Column to start from, set to the column the slide stops in
+ */
+void MazeGrid::slide(int direction, int &row, int &col) const {
+	if (stops != NULL && direction >= 0 && direction < DIRECTION_COUNT) {
+		int stop = stops[((long)row * gridSize + col) * DIRECTION_COUNT + direction];
+		if (direction == NORTH || direction == SOUTH) {
+			row = stop;
+		} else {
+			col = stop;
+		}
+		return;
+	}
+
+	switch (direction) {
+		case NORTH:
+			row = previousBlock(getColumn(col), row - 1) + 1;
+			break;
+
+		case SOUTH:
+			row = nextBlock(getColumn(col), row + 1) - 1;
+			break;
+
+		case EAST:
+			col = nextBlock(getRow(row), col + 1) - 1;
+			break;
+
+		case WEST:
+			col = previousBlock(getRow(row), col - 1) + 1;
+			break;
+
+		default:
+			// You are standing in an open field west of a white house, 
+			// with a boarded front door. There is a small mailbox here.
+			break;
+	}
+}
+
+/**
+ * @return Number of blocks in the maze
+ */
+long MazeGrid::countBlocks() const {
+	long count = 0;
+	for (long i = 0; i < (long)gridSize * wordsPerRow; i++) {
+		count += __builtin_popcountll(rows[i]);
+	}
+	return count;
+}
+
+/**
+ * Set the square the ball has to reach
+ */
+void MazeGrid::setGoal(int row, int col) {
+	goalRow = row;
+	goalCol = col;
+}
+
+/**
+ * Set the square the ball starts in
+ */
+void MazeGrid::setStart(int row, int col) {
+	startRow = row;
+	startCol = col;
+}
+
+int MazeGrid::getGoalRow() const {
+	return goalRow;
+}
+
+int MazeGrid::getGoalCol() const {
+	return goalCol;
+}
+
+int MazeGrid::getStartRow() const {
+	return startRow;
+}
+
+int MazeGrid::getStartCol() const {
+	return startCol;
+}
@@ -0,0 +1,106 @@
+/**
+ * Square maze grid, with the walls stored as a bitmap.
+ * Each row is a whole number of 64 bit words, with column c in bit (c % 64)
+ * of word (c / 64), and a set bit is a block. This is the layout of the
+ * binary maze format, so a grid loaded from a binary file points straight
+ * into the memory mapped file. Otherwise the grid owns its words.
+ *
+ * A transposed copy of the walls, built by buildColumns(), has one bit row per
+ * column, so slides along a row or a column both scan contiguous words and
+ * can skip 64 squares at a time with a bit scan.
+ *
+ * Mazes up to SLIDE_TABLE_MAX_SIZE can also have a table of where every
+ * slide stops, built by buildSlideTable(), which makes a slide one lookup.
+ * It holds one 16 bit row or column per square and direction, 8 bytes per
+ * square, with the four directions of a square next to each other.
+ *
+ * The goal and the square the ball starts in are kept alongside the walls.
+ * Grids can be moved but not copied.
+ */
+
+#ifndef MAZEGRID_H
+#define MAZEGRID_H
+
+#include <cstddef>
+#include <stdint.h>
+
+// Largest maze with a slide table, which takes 128 MB at this size
+#define SLIDE_TABLE_MAX_SIZE 4096
+
+void transposeBlock(uint64_t *block);
+
+class MazeGrid {
+private:
+	int gridSize;
+	int wordsPerRow;
+	const uint64_t *rows;
+	uint64_t *columns;	// transposed walls, NULL until built
+	uint16_t *stops;	// where slides stop, NULL until built
+	int goalRow, goalCol;
+	int startRow, startCol;
+
+	// What the grid owns, released by the destructor
+	uint64_t *ownedRows;
+	void *mapping;
+	size_t mappingLength;
+
+	void release();
+
+	int nextBlock(const uint64_t *words, int from) const;
+	int previousBlock(const uint64_t *words, int from) const;
+	void fillRowStops(int row, int firstCol, int lastCol);
+	void fillColumnStops(int col, int firstRow, int lastRow);
+
+public:
+	MazeGrid();
+	~MazeGrid();
+	MazeGrid(MazeGrid &&other);
+	MazeGrid &operator=(MazeGrid &&other);
+	MazeGrid(const MazeGrid &) = delete;
+	MazeGrid &operator=(const MazeGrid &) = delete;
+
+	uint64_t *allocate(int size);
+	void adoptMapping(void *mapping, size_t length, const uint64_t *rows, int size);
+	void buildColumns();
+	void detach();
+	void buildSlideTable();
+	void takeSlideTable(MazeGrid &other);
+	void updateSlideTable(int row, int col);
+
+	void setGoal(int row, int col);
+	void setStart(int row, int col);
+	int getGoalRow() const;
+	int getGoalCol() const;
+	int getStartRow() const;
+	int getStartCol() const;
+
+	int size() const {
+		return gridSize;
+	}
+
+	int getWordsPerRow() const {
+		return wordsPerRow;
+	}
+
+	const uint64_t *getRow(int row) const {
+		return rows + (long)row * wordsPerRow;
+	}
+
+	const uint64_t *getColumn(int col) const {
+		return columns + (long)col * wordsPerRow;
+	}
+
+	bool hasSlideTable() const {
+		return stops != NULL;
+	}
+
+	bool isBlock(int row, int col) const {
+		return (getRow(row)[col >> 6] >> (col & 63)) & 1;
+	}
+
+	void slide(int direction, int &row, int &col) const;
+	void findBlockRun(const uint64_t *words, int from, int &first, int &last) const;
+	long countBlocks() const;
+};
+
+#endif
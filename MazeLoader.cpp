@@ -0,0 +1,314 @@
+#include "MazeBinary.h"
+#include "MazeLoader.h"
+#include "TileStore.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/**
+ * Set a loading error message
+ * @param error Message to set
+ * @param path Maze file
+ * @param line Line of the file the error is on, 0 for the whole file
+ * @param column Column of the line, 0 for the whole line
+ * @param message What is wrong
+ */
+void setMazeError(std::string &error, const char *path, long line, long column, const char *message) {
+	char location[64] = "";
+	if (line > 0 && column > 0) {
+		snprintf(location, sizeof(location), ":%ld:%ld", line, column);
+	} else if (line > 0) {
+		snprintf(location, sizeof(location), ":%ld", line);
+	}
+	error = std::string(path) + location + ": " + message;
+}
+
+/**
+ * Length of the line ending at a position
+ * @return 1 for "\n" or a "\r" at the end of the file, 2 for "\r\n",
+ *	0 at the end of the file, -1 if there is no line ending here
+ */
+int lineEndLength(const char *position, const char *end) {
+	if (position == end) {
+		return 0;
+	}
+	if (*position == '\n') {
+		return 1;
+	}
+	if (*position == '\r') {
+		if (position + 1 == end) {
+			return 1;
+		}
+		if (position[1] == '\n') {
+			return 2;
+		}
+	}
+	return -1;
+}
+
+/**
+ * Read the size from the first line
+ * @param position Start of the file, moved to the first row
+ * @return Size, or -1 if the line isn't a number followed by a line ending
+ */
+long parseMazeSize(const char *&position, const char *end) {
+	const char *p = position;
+	while (p < end && *p == ' ') {
+		p++;
+	}
+
+	long size = 0;
+	const char *digits = p;
+	while (p < end && *p >= '0' && *p <= '9') {
+		// Stop growing once too large, it is rejected either way
+		if (size <= MAZE_MAX_SIZE) {
+			size = size*10 + (*p - '0');
+		}
+		p++;
+	}
+	if (p == digits) {
+		return -1;
+	}
+
+	while (p < end && *p == ' ') {
+		p++;
+	}
+	int endLength = lineEndLength(p, end);
+	if (endLength < 0) {
+		return -1;
+	}
+
+	position = p + endLength;
+	return size;
+}
+
+// Every byte of a word set to the same value
+#define BYTES(value) (0x0101010101010101ull * (unsigned char)(value))
+
+/**
+ * Compare 8 characters at once
+ * @return 0x80 in each byte of chars that equals the byte, 0 elsewhere
+ */
+uint64_t matchingBytes(uint64_t chars, unsigned char byte) {
+	uint64_t difference = chars ^ BYTES(byte);
+	return ~(((difference & BYTES(0x7f)) + BYTES(0x7f)) | difference) & BYTES(0x80);
+}
+
+/**
+ * Check and pack 8 squares
+ * @param squares First of the 8 squares
+ * @param invalid Set to 1 if any square isn't ' ', '*' or 'X'
+ * @param goals Increased by the number of 'X' squares
+ * @return Blocks, square i in bit i
+ */
+unsigned int packSquares(const char *squares, int &invalid, int &goals) {
+	uint64_t chars;
+	memcpy(&chars, squares, sizeof(chars));
+
+	uint64_t blocks = matchingBytes(chars, '*');
+	uint64_t goal = matchingBytes(chars, 'X');
+	invalid |= (blocks | goal | matchingBytes(chars, ' ')) != BYTES(0x80);
+	goals += __builtin_popcountll(goal);
+
+	// Gather the top bit of each byte into one byte
+	return ((blocks >> 7) * 0x0102040810204080ull) >> 56;
+}
+
+/**
+ * Check the rows and pack their blocks into the grid
+ * @param firstRow First character of the first row
+ * @param end End of the file
+ * @param size Number of rows and columns
+ * @param grid Grid to fill, replaced by an empty grid of this size first
+ * @return false if the rows are invalid, with the error set
+ */
+bool readMazeRows(const char *firstRow, const char *end, int size, MazeGrid &grid,
+	const char *path, std::string &error) {
+
+	char message[128];
+	long goals = 0;
+	long goalLine = 0, goalColumn = 0;
+
+	uint64_t *words = grid.allocate(size);
+	int wordsPerRow = grid.getWordsPerRow();
+
+	const char *row = firstRow;
+	for (int rowIndex = 0; rowIndex < size; rowIndex++) {
+		long line = rowIndex + 2;
+
+		// Check and pack the whole row without branching, 8 squares at a time.
+		// Only look at the squares one by one to describe an error.
+		long available = end - row;
+		int invalid = available < size;
+		int rowGoals = 0;
+		int length = available < size ? (int)available : size;
+		for (int word = 0; word < wordsPerRow; word++) {
+			int first = word * 64;
+			int last = first + 64 < length ? first + 64 : length;
+			uint64_t blocks = 0;
+			int col = first;
+			for (; col + 8 <= last; col += 8) {
+				blocks |= (uint64_t)packSquares(row + col, invalid, rowGoals) << (col - first);
+			}
+			for (; col < last; col++) {
+				unsigned char square = row[col];
+				invalid |= (square != ' ') & (square != '*') & (square != 'X');
+				rowGoals += square == 'X';
+				blocks |= (uint64_t)(square == '*') << (col - first);
+			}
+			words[(long)rowIndex * wordsPerRow + word] = blocks;
+		}
+
+		if (invalid) {
+			int col = 0;
+			while (col < length && (row[col] == ' ' || row[col] == '*' || row[col] == 'X')) {
+				col++;
+			}
+
+			if (col < length && row[col] != '\n' && row[col] != '\r') {
+				snprintf(message, sizeof(message), "unexpected character 0x%02x, squares must be ' ', '*' or 'X'",
+					(unsigned char)row[col]);
+				setMazeError(error, path, line, col + 1, message);
+			} else if (col == available) {
+				snprintf(message, sizeof(message), "file ends after %d of %d rows", rowIndex, size);
+				setMazeError(error, path, line, 0, message);
+			} else {
+				snprintf(message, sizeof(message), "row has %d squares, expected %d", col, size);
+				setMazeError(error, path, line, 0, message);
+			}
+			return false;
+		}
+
+		if (rowGoals > 0) {
+			goals += rowGoals;
+			goalLine = line;
+			goalColumn = (const char *)memchr(row, 'X', size) - row + 1;
+			grid.setGoal(rowIndex, goalColumn - 1);
+		}
+
+		int endLength = lineEndLength(row + size, end);
+		if (endLength < 0) {
+			snprintf(message, sizeof(message), "row has more than %d squares", size);
+			setMazeError(error, path, line, size + 1, message);
+			return false;
+		}
+		if (endLength == 0 && rowIndex < size - 1) {
+			snprintf(message, sizeof(message), "file ends after %d of %d rows", rowIndex + 1, size);
+			setMazeError(error, path, line + 1, 0, message);
+			return false;
+		}
+		row += size + endLength;
+	}
+
+	// Only blank lines may follow the rows
+	long line = size + 2;
+	for (const char *p = row; p < end; p++) {
+		if (*p == '\n') {
+			line++;
+		} else if (*p != ' ' && *p != '\r' && *p != '\t') {
+			setMazeError(error, path, line, 0, "unexpected text after the last row");
+			return false;
+		}
+	}
+
+	if (goals != 1) {
+		snprintf(message, sizeof(message), "maze has %ld goals ('X'), expected 1", goals);
+		setMazeError(error, path, goals > 1 ? goalLine : 0, goals > 1 ? goalColumn : 0, message);
+		return false;
+	}
+	if (grid.isBlock(0, 0)) {
+		setMazeError(error, path, 2, 1, "the ball starts in the top left square, it can't be a block");
+		return false;
+	}
+
+	return true;
+}
+
+/**
+ * Load and check a maze file, in either format
+ * @param path Path to the maze file
+ * @param grid Grid to load into, with its columns built. Left unchanged if loading fails.
+ * @param error Set to a message with the file, line and column if loading fails
+ * @return true if the maze was loaded
+ */
+bool loadMazeFile(const char *path, MazeGrid &grid, std::string &error) {
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		setMazeError(error, path, 0, 0, strerror(errno));
+		return false;
+	}
+
+	struct stat info;
+	if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode)) {
+		close(fd);
+		setMazeError(error, path, 0, 0, "not a regular file");
+		return false;
+	}
+	if (info.st_size == 0) {
+		close(fd);
+		setMazeError(error, path, 0, 0, "file is empty");
+		return false;
+	}
+
+	size_t length = info.st_size;
+	void *mapping = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (mapping == MAP_FAILED) {
+		setMazeError(error, path, 0, 0, strerror(errno));
+		return false;
+	}
+	madvise(mapping, length, MADV_SEQUENTIAL);
+
+	// A binary maze is used where it is, the grid takes over the mapping
+	if (isMazeBinary(mapping, length)) {
+		if (!loadMazeBinary(mapping, length, path, grid, error)) {
+			munmap(mapping, length);
+			return false;
+		}
+		grid.buildColumns();
+		return true;
+	}
+
+	// Tiled mazes are too big to load whole, they are read a tile at a time by a TileStore
+	if (isMazeTiled(mapping, length)) {
+		munmap(mapping, length);
+		setMazeError(error, path, 0, 0, "tiled mazes can only be paged in, not loaded whole");
+		return false;
+	}
+
+	const char *data = (const char *)mapping;
+	const char *end = data + length;
+	const char *firstRow = data;
+
+	long size = parseMazeSize(firstRow, end);
+	if (size < 0) {
+		munmap(mapping, length);
+		setMazeError(error, path, 1, 0, "first line must be the maze size");
+		return false;
+	}
+	if (size < 2 || size > MAZE_MAX_SIZE) {
+		munmap(mapping, length);
+		char message[64];
+		snprintf(message, sizeof(message), "maze size must be from 2 to %d", MAZE_MAX_SIZE);
+		setMazeError(error, path, 1, 0, message);
+		return false;
+	}
+
+	MazeGrid loaded;
+	bool valid = readMazeRows(firstRow, end, size, loaded, path, error);
+	munmap(mapping, length);
+	if (!valid) {
+		return false;
+	}
+
+	grid = std::move(loaded);
+	grid.buildColumns();
+	return true;
+}
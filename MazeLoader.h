@@ -0,0 +1,26 @@
+/**
+ * Load a maze file into a MazeGrid.
+ * Files in the binary format (see MazeBinary.h) are recognised by their
+ * magic number. Anything else is read as text.
+ *
+ * Text files are memory mapped and checked in one pass: the first line is the
+ * size N, followed by exactly N rows of N squares. A square is ' ' (empty),
+ * '*' (block) or 'X' (goal), and there must be exactly one goal. Rows may
+ * end in "\n" or "\r\n". The blocks are packed into the grid's bitmap as
+ * each row is checked, so the text is never held in memory.
+ */
+
+#ifndef MAZELOADER_H
+#define MAZELOADER_H
+
+#include <string>
+
+#include "MazeGrid.h"
+
+// Largest maze size accepted, keeps every square index within an int
+#define MAZE_MAX_SIZE 32768
+
+bool loadMazeFile(const char *path, MazeGrid &grid, std::string &error);
+void setMazeError(std::string &error, const char *path, long line, long column, const char *message);
+
+#endif
@@ -0,0 +1,121 @@
+#include "MeshFormat.h"
+
+#include <GL/glew.h>
+
+#include <cstring>
+#include <math.h>
+
+// Largest finite half float, and the smallest one with full precision
+#define HALF_MAX 65504.0f
+#define HALF_MIN_NORMAL 6.103515625e-05f	// 2^-14
+
+/**
+ * Convert a float to a half float, rounding away from zero
+ * Rounding outwards means neighbouring cubes overlap very slightly instead
+ * of leaving hairline gaps between them.
+ * Only valid for zero and values that pass fitsHalfFloat.
+ * @param value Value to convert
+ * @return Half float bits
+ */
+static unsigned short floatToHalf(float value) {
+	unsigned int bits;
+	std::memcpy(&bits, &value, sizeof(bits));
+
+	unsigned short sign = (bits >> 16) & 0x8000;
+	if ((bits & 0x7fffffff) == 0) {
+		return sign;
+	}
+
+	int exponent = (int)((bits >> 23) & 0xff) - 127 + 15;
+	unsigned int mantissa = bits & 0x7fffff;
+
+	unsigned short half = sign | (exponent << 10) | (mantissa >> 13);
+
+	// Dropped bits: round the magnitude up, carrying into the exponent if needed
+	if (mantissa & 0x1fff) {
+		half++;
+	}
+
+	return half;
+}
+
+/**
+ * Check that values can be stored as half floats without losing more than
+ * half float precision (about 3 significant digits)
+ * @param values Values to check
+ * @param count Number of values
+ * @return true if every value is zero or a normal half float
+ */
+bool fitsHalfFloat(const float *values, int count) {
+	for (int i = 0; i < count; i++) {
+		float magnitude = fabs(values[i]);
+		if (magnitude != 0.0f && (magnitude < HALF_MIN_NORMAL || magnitude >= HALF_MAX)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/**
+ * Pack x,y,z positions as half floats, padded to 4 values so each vertex
+ * stays 4 byte aligned
+ * @param positions x,y,z of each vertex
+ * @param vertexCount Number of vertices
+ * @param packed Filled with 4 half floats per vertex
+ */
+void packHalfFloatPositions(const float *positions, int vertexCount, 
+	std::vector<unsigned short> &packed) {
+	packed.resize(vertexCount * 4);
+
+	for (int i = 0; i < vertexCount; i++) {
+		packed[i*4] = floatToHalf(positions[i*3]);
+		packed[i*4 + 1] = floatToHalf(positions[i*3 + 1]);
+		packed[i*4 + 2] = floatToHalf(positions[i*3 + 2]);
+		packed[i*4 + 3] = 0;
+	}
+}
+
+/**
+ * Find the smallest index type that can hold every index
+ * 8 bit indices are not used, they are slow on a lot of hardware.
+ * @param indices Indices to check
+ * @param count Number of indices
+ * @return GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+ */
+unsigned int smallestIndexType(const unsigned int *indices, int count) {
+	for (int i = 0; i < count; i++) {
+		if (indices[i] > 0xffff) {
+			return GL_UNSIGNED_INT;
+		}
+	}
+	return GL_UNSIGNED_SHORT;
+}
+
+/**
+ * @param indexType GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+ * @return Size of one index in bytes
+ */
+int indexTypeSize(unsigned int indexType) {
+	return (indexType == GL_UNSIGNED_SHORT) ? sizeof(unsigned short) : sizeof(unsigned int);
+}
+
+/**
+ * Store indices as the given type, ready to upload
+ * @param indices Indices to pack
+ * @param count Number of indices
+ * @param indexType Type from smallestIndexType
+ * @param packed Filled with the packed indices
+ */
+void packIndices(const unsigned int *indices, int count, unsigned int indexType, 
+	std::vector<unsigned char> &packed) {
+	packed.resize(count * indexTypeSize(indexType));
+
+	if (indexType == GL_UNSIGNED_SHORT) {
+		for (int i = 0; i < count; i++) {
+			unsigned short index = indices[i];
+			std::memcpy(&packed[i * sizeof(index)], &index, sizeof(index));
+		}
+	} else {
+		std::memcpy(packed.data(), indices, count * sizeof(unsigned int));
+	}
+}
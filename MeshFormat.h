@@ -0,0 +1,21 @@
+/**
+ * Compact vertex and index formats for uploading meshes.
+ * Positions are packed as half floats and indices as 16 bit values
+ * when every value fits, which halves the data read per vertex.
+ */
+
+#ifndef MESHFORMAT_H
+#define MESHFORMAT_H
+
+#include <vector>
+
+bool fitsHalfFloat(const float *values, int count);
+void packHalfFloatPositions(const float *positions, int vertexCount, 
+	std::vector<unsigned short> &packed);
+
+unsigned int smallestIndexType(const unsigned int *indices, int count);
+int indexTypeSize(unsigned int indexType);
+void packIndices(const unsigned int *indices, int count, unsigned int indexType, 
+	std::vector<unsigned char> &packed);
+
+#endif
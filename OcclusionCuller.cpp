@@ -0,0 +1,222 @@
+#include "OcclusionCuller.h"
+
+#include <algorithm>
+#include <limits>
+#include <math.h>
+
+// A ray must pass this far through a run of blocks to be blocked by it, as a
+// fraction of the ray. Rays that only graze a run don't count.
+#define OCCLUSION_EPSILON 1e-4f
+
+/**
+ * Everything starts visible
+ * @param grid Grid of characters that specify the maze, with its columns built
+ * @param cubeWidth Width of one grid square
+ * @param topLeft Centre of the top left grid square in world coordinates
+ */
+OcclusionCuller::OcclusionCuller(const MazeGrid &grid, float cubeWidth, glm::vec3 topLeft):
+	grid(grid),
+	gridSize(grid.size()),
+	cubeWidth(cubeWidth),
+	topLeft(topLeft),
+	active(false) {
+}
+
+bool OcclusionCuller::isBlock(int row, int col) {
+	return grid.isBlock(row, col);
+}
+
+/**
+ * Find the first square of the run of blocks through a square
+ * @param words Row or column of walls
+ * @param from Square that is a block
+ * @return Index of the first block of the run
+ */
+static int findRunStart(const uint64_t *words, int from) {
+	int word = from >> 6;
+	uint64_t free = ~words[word] & (~0ull >> (63 - (from & 63)));
+	while (free == 0) {
+		if (--word < 0) {
+			return 0;
+		}
+		free = ~words[word];
+	}
+	return word*64 + 63 - __builtin_clzll(free) + 1;
+}
+
+/**
+ * Number the horizontal run of neighbouring blocks through a block
+ * Each run is a box from the bottom of the floor to the top of the blocks,
+ * which is what rays are tested against. Row runs are numbered by their
+ * first square, column runs after all of them.
+ * @return Number of the run
+ */
+long OcclusionCuller::findRowRun(int row, int col) {
+	return (long)row * gridSize + findRunStart(grid.getRow(row), col);
+}
+
+/**
+ * Number the vertical run of neighbouring blocks through a block
+ * @return Number of the run
+ */
+long OcclusionCuller::findColRun(int row, int col) {
+	return (long)gridSize * gridSize + (long)col * gridSize + findRunStart(grid.getColumn(col), row);
+}
+
+/**
+ * Walk the ray from the eye to a point through the grid (2D DDA), and
+ * collect the runs of blocks it passes through on the way
+ * Only the part of the ray between the bottom of the floor and the top of the
+ * blocks is walked, nothing above or below it can block the ray.
+ * @param point End of the ray
+ */
+void OcclusionCuller::findBlockers(glm::vec3 point) {
+	blockers.clear();
+
+	glm::vec3 direction = point - eye;
+	float bottom = -cubeWidth/2.0f;
+	float top = cubeWidth;
+
+	// Part of the ray at wall height
+	float tStart = 0.0f;
+	float tEnd = 1.0f;
+	if (direction.y != 0.0f) {
+		float tTop = (top - eye.y) / direction.y;
+		float tBottom = (bottom - eye.y) / direction.y;
+		tStart = std::max(tStart, std::min(tTop, tBottom));
+		tEnd = std::min(tEnd, std::max(tTop, tBottom));
+	} else if (eye.y < bottom || eye.y > top) {
+		return;
+	}
+	if (tStart >= tEnd) {
+		return;
+	}
+
+	// Grid coordinates, grid square (row, col) covers [col, col+1) x [row, row+1)
+	float u = (eye.x + tStart*direction.x - topLeft.x) / cubeWidth + 0.5f;
+	float v = (eye.z + tStart*direction.z - topLeft.z) / cubeWidth + 0.5f;
+	float du = direction.x / cubeWidth;
+	float dv = direction.z / cubeWidth;
+
+	int col = (int)floor(u);
+	int row = (int)floor(v);
+
+	float infinity = std::numeric_limits<float>::infinity();
+	int colStep = (du > 0.0f) ? 1 : -1;
+	int rowStep = (dv > 0.0f) ? 1 : -1;
+	float tColDelta = (du != 0.0f) ? fabs(1.0f / du) : infinity;
+	float tRowDelta = (dv != 0.0f) ? fabs(1.0f / dv) : infinity;
+	float tNextCol = (du > 0.0f) ? tStart + ((float)(col + 1) - u) / du :
+		(du < 0.0f) ? tStart + ((float)col - u) / du : infinity;
+	float tNextRow = (dv > 0.0f) ? tStart + ((float)(row + 1) - v) / dv :
+		(dv < 0.0f) ? tStart + ((float)row - v) / dv : infinity;
+
+	float tEnter = tStart;
+	while (tEnter < tEnd) {
+		float tExit = std::min(std::min(tNextCol, tNextRow), tEnd);
+
+		if (tExit - tEnter > OCCLUSION_EPSILON &&
+			row >= 0 && row < gridSize && col >= 0 && col < gridSize && isBlock(row, col)) {
+			long rowRun = findRowRun(row, col);
+			long colRun = findColRun(row, col);
+			if (std::find(blockers.begin(), blockers.end(), rowRun) == blockers.end()) {
+				blockers.push_back(rowRun);
+			}
+			if (std::find(blockers.begin(), blockers.end(), colRun) == blockers.end()) {
+				blockers.push_back(colRun);
+			}
+		}
+
+		if (tNextCol < tNextRow) {
+			col += colStep;
+			tEnter = tNextCol;
+			tNextCol += tColDelta;
+		} else {
+			row += rowStep;
+			tEnter = tNextRow;
+			tNextRow += tRowDelta;
+		}
+	}
+}
+
+/**
+ * Check if a box is entirely behind one run of blocks
+ * A run is a box, and the shadow of a box is convex, so it is enough that
+ * every corner is in the shadow of the same run.
+ * @param boxMin Minimum corner, a flat box has only 4 corners tested
+ * @param boxMax Maximum corner
+ * @return true if nothing in the box can be seen from the eye
+ */
+bool OcclusionCuller::isBoxHidden(glm::vec3 boxMin, glm::vec3 boxMax) {
+	bool first = true;
+	for (int corner = 0; corner < 8; corner++) {
+		if ((corner & 2) && boxMin.y == boxMax.y) {
+			continue;
+		}
+
+		glm::vec3 point((corner & 1) ? boxMax.x : boxMin.x,
+			(corner & 2) ? boxMax.y : boxMin.y,
+			(corner & 4) ? boxMax.z : boxMin.z);
+		findBlockers(point);
+
+		// Keep the runs that block every corner so far
+		if (first) {
+			candidates = blockers;
+			first = false;
+		} else {
+			for (int i = candidates.size() - 1; i >= 0; i--) {
+				if (std::find(blockers.begin(), blockers.end(), candidates[i]) == blockers.end()) {
+					candidates.erase(candidates.begin() + i);
+				}
+			}
+		}
+
+		if (candidates.empty()) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/**
+ * Move the eye. Boxes are tested from the new position straight away.
+ * @param eye Camera position in world coordinates
+ */
+void OcclusionCuller::setEye(glm::vec3 eye) {
+	this->eye = eye;
+
+	// From below the floor or inside a block every ray would be blocked.
+	// Don't trust the result there, draw everything instead.
+	int eyeRow = (int)floor((eye.z - topLeft.z) / cubeWidth + 0.5f);
+	int eyeCol = (int)floor((eye.x - topLeft.x) / cubeWidth + 0.5f);
+	bool eyeInGrid = eyeRow >= 0 && eyeRow < gridSize && eyeCol >= 0 && eyeCol < gridSize;
+	active = !(eye.y <= 0.0f || (eyeInGrid && eye.y <= cubeWidth && isBlock(eyeRow, eyeCol)));
+}
+
+/**
+ * Treat everything as visible until the eye is set again
+ */
+void OcclusionCuller::disable() {
+	active = false;
+}
+
+/**
+ * Check a box, such as a chunk of the maze
+ * @param boxMin Minimum corner in world coordinates
+ * @param boxMax Maximum corner in world coordinates
+ * @return false if the whole box is hidden from the eye
+ */
+bool OcclusionCuller::isBoxVisible(glm::vec3 boxMin, glm::vec3 boxMax) {
+	if (!active) {
+		return true;
+	}
+	return !isBoxHidden(boxMin, boxMax);
+}
+
+/**
+ * @return false if occlusion culling is off or can't be trusted from the current eye
+ */
+bool OcclusionCuller::isActive() {
+	return active;
+}
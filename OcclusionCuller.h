@@ -0,0 +1,59 @@
+/**
+ * Occlusion culling using the maze grid itself.
+ * Rays are walked through the grid from the eye to the corners of a box,
+ * such as a chunk of the maze. The box is hidden when every corner is behind
+ * the same straight run of blocks: a run is a box, so anything whose corners
+ * are all in its shadow is entirely in its shadow.
+ *
+ * Rays are tested against the height of the walls, so the result is correct
+ * from any camera height. When the camera is above the walls, block tops are
+ * always in view and only boxes below the top of the walls can be hidden.
+ *
+ * Runs are found from the grid's row and column bitmaps when a ray reaches
+ * them, so nothing is stored per square and edits to the grid are seen
+ * straight away.
+ *
+ * Grid positions use columns along x and rows along z, relative to the centre
+ * of the top left grid square.
+ */
+
+#ifndef OCCLUSIONCULLER_H
+#define OCCLUSIONCULLER_H
+
+#include <vector>
+
+#include "glm/glm.hpp"
+
+#include "MazeGrid.h"
+
+class OcclusionCuller {
+private:
+	const MazeGrid &grid;
+	int gridSize;
+	float cubeWidth;
+	glm::vec3 topLeft;
+
+	bool active;
+	glm::vec3 eye;
+
+	// Reused by each box test to avoid allocating
+	std::vector<long> candidates, blockers;
+
+	bool isBlock(int row, int col);
+	long findRowRun(int row, int col);
+	long findColRun(int row, int col);
+	void findBlockers(glm::vec3 point);
+	bool isBoxHidden(glm::vec3 boxMin, glm::vec3 boxMax);
+
+public:
+	OcclusionCuller(const MazeGrid &grid, float cubeWidth, glm::vec3 topLeft);
+
+	void setEye(glm::vec3 eye);
+	void disable();
+
+	bool isBoxVisible(glm::vec3 boxMin, glm::vec3 boxMax);
+
+	bool isActive();
+};
+
+#endif
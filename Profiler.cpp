@@ -0,0 +1,290 @@
+#include "Profiler.h"
+
+#include <GL/glew.h>
+
+#include <chrono>
+#include <sstream>
+
+const char *phaseNames[PROFILE_PHASE_COUNT] = {
+	"world", "floor", "blocks", "goal", "ball", "swap"
+};
+
+/**
+ * @return Time in milliseconds from a steady clock
+ */
+double nowMs() {
+	return std::chrono::duration<double, std::milli>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/**
+ * Profiler starts disabled. Queries are created the first time it is enabled.
+ */
+Profiler::Profiler():
+	enabled(false),
+	frame(0),
+	frameStart(0.0),
+	history(PROFILER_HISTORY),
+	csvFile(NULL) {
+
+	for (int slot = 0; slot < PROFILER_QUERY_FRAMES; slot++) {
+		queryFrame[slot] = -1;
+		for (int phase = 0; phase < PROFILE_PHASE_COUNT; phase++) {
+			queries[slot][phase] = 0;
+			queryIssued[slot][phase] = false;
+		}
+	}
+	for (int i = 0; i < PROFILER_HISTORY; i++) {
+		history[i].frame = -1;
+	}
+}
+
+/**
+ * Frames still in flight are waited for and written to the CSV file
+ * Needs the OpenGL context to still be current.
+ */
+Profiler::~Profiler() {
+	if (queries[0][0] != 0) {
+		glFinish();
+		for (long f = frame - PROFILER_QUERY_FRAMES; f < frame; f++) {
+			if (f >= 0) {
+				collectQueries(f % PROFILER_QUERY_FRAMES);
+			}
+		}
+		glDeleteQueries(PROFILER_QUERY_FRAMES * PROFILE_PHASE_COUNT, &queries[0][0]);
+	}
+	if (csvFile != NULL) {
+		fclose(csvFile);
+	}
+}
+
+/**
+ * Turn profiling on or off. Needs a current OpenGL context.
+ */
+void Profiler::setEnabled(bool enabled) {
+	if (enabled && queries[0][0] == 0) {
+		glGenQueries(PROFILER_QUERY_FRAMES * PROFILE_PHASE_COUNT, &queries[0][0]);
+	}
+	this->enabled = enabled;
+}
+
+bool Profiler::isEnabled() {
+	return enabled;
+}
+
+/**
+ * Write one CSV row per profiled frame to a file, once its GPU times are known
+ * @param path File to write to
+ * @return true if the file could be opened
+ */
+bool Profiler::openCsv(const char *path) {
+	csvFile = fopen(path, "w");
+	if (csvFile == NULL) {
+		return false;
+	}
+
+	fprintf(csvFile, "frame,frame_ms");
+	for (int phase = 0; phase < PROFILE_PHASE_COUNT; phase++) {
+		fprintf(csvFile, ",cpu_%s_ms", phaseNames[phase]);
+	}
+	for (int phase = 0; phase < PROFILE_PHASE_COUNT; phase++) {
+		fprintf(csvFile, ",gpu_%s_ms", phaseNames[phase]);
+	}
+	fprintf(csvFile, "\n");
+
+	return true;
+}
+
+/**
+ * @return Ring buffer entry for a frame
+ */
+Profiler::FrameSample &Profiler::sample(long frame) {
+	return history[frame % PROFILER_HISTORY];
+}
+
+/**
+ * Start timing a new frame
+ * Results of the queries issued PROFILER_QUERY_FRAMES ago are collected first,
+ * so their query objects can be reused.
+ */
+void Profiler::beginFrame() {
+	if (!enabled) {
+		return;
+	}
+
+	int slot = frame % PROFILER_QUERY_FRAMES;
+	collectQueries(slot);
+	queryFrame[slot] = frame;
+
+	FrameSample &current = sample(frame);
+	current.frame = frame;
+	current.frameMs = 0.0;
+	for (int phase = 0; phase < PROFILE_PHASE_COUNT; phase++) {
+		current.cpuMs[phase] = 0.0;
+		current.gpuMs[phase] = 0.0;
+	}
+
+	frameStart = nowMs();
+}
+
+/**
+ * Finish timing the current frame
+ */
+void Profiler::endFrame() {
+	if (!enabled) {
+		return;
+	}
+
+	sample(frame).frameMs = nowMs() - frameStart;
+	frame++;
+}
+
+/**
+ * Start the CPU timer and GPU query of a phase
+ * Phases must not overlap, as only one GL_TIME_ELAPSED query can be active.
+ */
+void Profiler::beginPhase(int phase) {
+	if (!enabled) {
+		return;
+	}
+
+	int slot = frame % PROFILER_QUERY_FRAMES;
+	glBeginQuery(GL_TIME_ELAPSED, queries[slot][phase]);
+	queryIssued[slot][phase] = true;
+
+	phaseStart[phase] = nowMs();
+}
+
+/**
+ * Stop the CPU timer and GPU query of a phase
+ */
+void Profiler::endPhase(int phase) {
+	if (!enabled) {
+		return;
+	}
+
+	sample(frame).cpuMs[phase] += nowMs() - phaseStart[phase];
+	glEndQuery(GL_TIME_ELAPSED);
+}
+
+/**
+ * Read GPU times from the queries in a slot into the ring buffer
+ * The queries were issued several frames ago, so the results are normally ready.
+ * If they are not, they are dropped rather than waiting for the GPU.
+ */
+void Profiler::collectQueries(int slot) {
+	long queriedFrame = queryFrame[slot];
+	if (queriedFrame < 0) {
+		return;
+	}
+
+	FrameSample &queried = sample(queriedFrame);
+	bool complete = true;
+
+	for (int phase = 0; phase < PROFILE_PHASE_COUNT; phase++) {
+		if (!queryIssued[slot][phase]) {
+			continue;
+		}
+		queryIssued[slot][phase] = false;
+
+		int available = 0;
+		glGetQueryObjectiv(queries[slot][phase], GL_QUERY_RESULT_AVAILABLE, &available);
+		if (!available) {
+			complete = false;
+			continue;
+		}
+
+		GLuint64 elapsedNs;
+		glGetQueryObjectui64v(queries[slot][phase], GL_QUERY_RESULT, &elapsedNs);
+		if (queried.frame == queriedFrame) {
+			queried.gpuMs[phase] = elapsedNs / 1.0e6;
+		}
+	}
+
+	queryFrame[slot] = -1;
+
+	if (complete && queried.frame == queriedFrame) {
+		writeCsvRow(queried);
+	}
+}
+
+/**
+ * Append a frame to the CSV file, if one is open
+ */
+void Profiler::writeCsvRow(FrameSample &sample) {
+	if (csvFile == NULL) {
+		return;
+	}
+
+	fprintf(csvFile, "%ld,%.4f", sample.frame, sample.frameMs);
+	for (int phase = 0; phase < PROFILE_PHASE_COUNT; phase++) {
+		fprintf(csvFile, ",%.4f", sample.cpuMs[phase]);
+	}
+	for (int phase = 0; phase < PROFILE_PHASE_COUNT; phase++) {
+		fprintf(csvFile, ",%.4f", sample.gpuMs[phase]);
+	}
+	fprintf(csvFile, "\n");
+}
+
+/**
+ * Summarise recent frames for display
+ * Times are averaged over the frames in the ring buffer. Phases that took no
+ * time (e.g. floor and blocks when they are baked into the world) are left out.
+ * @return One line of text, e.g. "frame 2.10 ms | world cpu 0.05 gpu 0.80 | ..."
+ */
+std::string Profiler::overlayText() {
+	double frameMs = 0.0;
+	double cpuMs[PROFILE_PHASE_COUNT] = {0.0};
+	double gpuMs[PROFILE_PHASE_COUNT] = {0.0};
+	int count = 0;
+
+	// Skip the newest frames, whose GPU times aren't known yet
+	for (int i = 0; i < PROFILER_HISTORY; i++) {
+		FrameSample &s = history[i];
+		if (s.frame < 0 || s.frame >= frame - PROFILER_QUERY_FRAMES) {
+			continue;
+		}
+
+		frameMs += s.frameMs;
+		for (int phase = 0; phase < PROFILE_PHASE_COUNT; phase++) {
+			cpuMs[phase] += s.cpuMs[phase];
+			gpuMs[phase] += s.gpuMs[phase];
+		}
+		count++;
+	}
+
+	std::stringstream text;
+	text.precision(2);
+	text << std::fixed;
+
+	if (count == 0) {
+		text << "profiling...";
+		return text.str();
+	}
+
+	text << "frame " << frameMs / count << " ms";
+	for (int phase = 0; phase < PROFILE_PHASE_COUNT; phase++) {
+		if (cpuMs[phase] == 0.0 && gpuMs[phase] == 0.0) {
+			continue;
+		}
+		text << " | " << phaseNames[phase] 
+			<< " cpu " << cpuMs[phase] / count 
+			<< " gpu " << gpuMs[phase] / count;
+	}
+
+	return text.str();
+}
+
+ScopedPhase::ScopedPhase(Profiler *profiler, int phase):
+	profiler(profiler),
+	phase(phase) {
+	if (profiler != NULL) {
+		profiler->beginPhase(phase);
+	}
+}
+
+ScopedPhase::~ScopedPhase() {
+	if (profiler != NULL) {
+		profiler->endPhase(phase);
+	}
+}
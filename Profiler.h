@@ -0,0 +1,86 @@
+/**
+ * Frame profiler: CPU and GPU time spent in each phase of a frame.
+ * GPU times come from GL_TIME_ELAPSED queries that are read back a few frames
+ * later, so profiling never waits for the GPU. Results are kept in a ring
+ * buffer of recent frames and can be written to a CSV file.
+ * When disabled, every call returns straight away.
+ */
+
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// Phases of a frame that are timed
+#define PROFILE_PHASE_WORLD 0	// baked floor and blocks
+#define PROFILE_PHASE_FLOOR 1
+#define PROFILE_PHASE_BLOCKS 2
+#define PROFILE_PHASE_GOAL 3
+#define PROFILE_PHASE_BALL 4
+#define PROFILE_PHASE_SWAP 5
+#define PROFILE_PHASE_COUNT 6
+
+// Number of recent frames kept for the overlay
+#define PROFILER_HISTORY 120
+// Number of frames of GPU queries in flight before results are read
+#define PROFILER_QUERY_FRAMES 4
+
+class Profiler {
+private:
+	struct FrameSample {
+		long frame;
+		double frameMs;
+		double cpuMs[PROFILE_PHASE_COUNT];
+		double gpuMs[PROFILE_PHASE_COUNT];
+	};
+
+	bool enabled;
+	long frame;
+	double frameStart;
+	double phaseStart[PROFILE_PHASE_COUNT];
+
+	std::vector<FrameSample> history;
+
+	unsigned int queries[PROFILER_QUERY_FRAMES][PROFILE_PHASE_COUNT];
+	bool queryIssued[PROFILER_QUERY_FRAMES][PROFILE_PHASE_COUNT];
+	long queryFrame[PROFILER_QUERY_FRAMES];
+
+	FILE *csvFile;
+
+	FrameSample &sample(long frame);
+	void collectQueries(int slot);
+	void writeCsvRow(FrameSample &sample);
+
+public:
+	Profiler();
+	~Profiler();
+
+	void setEnabled(bool enabled);
+	bool isEnabled();
+	bool openCsv(const char *path);
+
+	void beginFrame();
+	void endFrame();
+	void beginPhase(int phase);
+	void endPhase(int phase);
+
+	std::string overlayText();
+};
+
+/**
+ * Times a phase from construction until the end of the enclosing scope
+ * The profiler may be NULL, in which case nothing is timed.
+ */
+class ScopedPhase {
+private:
+	Profiler *profiler;
+	int phase;
+
+public:
+	ScopedPhase(Profiler *profiler, int phase);
+	~ScopedPhase();
+};
+
+#endif
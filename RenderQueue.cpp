@@ -0,0 +1,141 @@
+#include "RenderQueue.h"
+#include "Profiler.h"
+
+#include <GL/glew.h>
+
+#include "glm/gtc/type_ptr.hpp"
+
+#include <algorithm>
+
+RenderQueue::RenderQueue():
+	drawCalls(0),
+	programBinds(0),
+	vaoBinds(0) {
+}
+
+/**
+ * Remove all draws, ready for the next frame
+ */
+void RenderQueue::clear() {
+	commands.clear();
+}
+
+/**
+ * Queue a draw of triangles from an indexed VAO
+ * @param programID Shader program to draw with
+ * @param vaoHandle VAO to draw
+ * @param modelUniformHandle Location of the model matrix in the program
+ * @param model Model matrix for this draw
+ * @param indicesCount Number of indices to draw
+ * @param indexType Type of the VAO's indices
+ * @param instanceCount Number of instances, or 0 to draw without instancing
+ * @param phase Profiler phase to time this draw in
+ */
+void RenderQueue::add(unsigned int programID, unsigned int vaoHandle, int modelUniformHandle, 
+	const glm::mat4 &model, int indicesCount, unsigned int indexType, int instanceCount, int phase) {
+	DrawCommand command;
+	command.programID = programID;
+	command.vaoHandle = vaoHandle;
+	command.modelUniformHandle = modelUniformHandle;
+	command.model = model;
+	command.indicesCount = indicesCount;
+	command.indexType = indexType;
+	command.instanceCount = instanceCount;
+	command.phase = phase;
+	command.order = commands.size();
+
+	commands.push_back(command);
+}
+
+/**
+ * Sort order: by program, then VAO, then the order the draws were added
+ */
+bool RenderQueue::drawsBefore(const DrawCommand &a, const DrawCommand &b) {
+	if (a.programID != b.programID) {
+		return a.programID < b.programID;
+	}
+	if (a.vaoHandle != b.vaoHandle) {
+		return a.vaoHandle < b.vaoHandle;
+	}
+	return a.order < b.order;
+}
+
+/**
+ * Sort the queued draws and submit them, only changing state between groups
+ * Each program is used by one render stage, so each profiler phase is
+ * started and stopped once.
+ * @param profiler Profiler to time phases with, or NULL
+ */
+void RenderQueue::submit(Profiler *profiler) {
+	std::sort(commands.begin(), commands.end(), drawsBefore);
+
+	drawCalls = 0;
+	programBinds = 0;
+	vaoBinds = 0;
+
+	unsigned int currentProgram = 0;
+	unsigned int currentVao = 0;
+	int currentPhase = -1;
+
+	for (int i = 0; i < commands.size(); i++) {
+		DrawCommand &command = commands[i];
+
+		if (command.phase != currentPhase && profiler != NULL) {
+			if (currentPhase != -1) {
+				profiler->endPhase(currentPhase);
+			}
+			profiler->beginPhase(command.phase);
+		}
+		currentPhase = command.phase;
+
+		if (command.programID != currentProgram) {
+			glUseProgram(command.programID);
+			currentProgram = command.programID;
+			currentVao = 0;
+			programBinds++;
+		}
+
+		if (command.vaoHandle != currentVao) {
+			glBindVertexArray(command.vaoHandle);
+			currentVao = command.vaoHandle;
+			vaoBinds++;
+		}
+
+		glUniformMatrix4fv(command.modelUniformHandle, 1, false, glm::value_ptr(command.model));
+		if (command.instanceCount > 0) {
+			glDrawElementsInstanced(GL_TRIANGLES, command.indicesCount, command.indexType, 0, 
+				command.instanceCount);
+		} else {
+			glDrawElements(GL_TRIANGLES, command.indicesCount, command.indexType, 0);
+		}
+		drawCalls++;
+	}
+
+	if (currentPhase != -1 && profiler != NULL) {
+		profiler->endPhase(currentPhase);
+	}
+
+	glBindVertexArray(0);
+	glFlush();
+}
+
+/**
+ * @return Number of draw calls made by the last submit()
+ */
+int RenderQueue::getDrawCalls() {
+	return drawCalls;
+}
+
+/**
+ * @return Number of times a program was bound by the last submit()
+ */
+int RenderQueue::getProgramBinds() {
+	return programBinds;
+}
+
+/**
+ * @return Number of times a VAO was bound by the last submit()
+ */
+int RenderQueue::getVaoBinds() {
+	return vaoBinds;
+}
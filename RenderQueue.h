@@ -0,0 +1,51 @@
+/**
+ * Collects the draw calls of a frame, then submits them sorted by shader
+ * program and VAO, so each program is bound once per frame and draws that
+ * share a VAO are submitted together.
+ */
+
+#ifndef RENDERQUEUE_H
+#define RENDERQUEUE_H
+
+#include <vector>
+
+#include "glm/glm.hpp"
+
+class Profiler;
+
+class RenderQueue {
+private:
+	struct DrawCommand {
+		unsigned int programID;
+		unsigned int vaoHandle;
+		int modelUniformHandle;
+		glm::mat4 model;
+		int indicesCount;
+		unsigned int indexType;	// GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+		int instanceCount;	// 0 for a normal draw
+		int phase;			// profiler phase the draw is timed in
+		int order;			// keeps draws in the order they were added within a group
+	};
+
+	std::vector<DrawCommand> commands;
+
+	int drawCalls;
+	int programBinds;
+	int vaoBinds;
+
+	static bool drawsBefore(const DrawCommand &a, const DrawCommand &b);
+
+public:
+	RenderQueue();
+
+	void clear();
+	void add(unsigned int programID, unsigned int vaoHandle, int modelUniformHandle, 
+		const glm::mat4 &model, int indicesCount, unsigned int indexType, int instanceCount, int phase);
+	void submit(Profiler *profiler);
+
+	int getDrawCalls();
+	int getProgramBinds();
+	int getVaoBinds();
+};
+
+#endif
@@ -1,35 +1,51 @@
 #include <cstdio>
+#include <cstdlib>
 #include <string>
 #include <vector>
 #include <iostream>
 #include <fstream>
+#include <sstream>
+
+#include <sys/stat.h>
 
 #include <GL/glew.h>
 
 #include "Shader.hpp"
 
-int CompileShader(const char *ShaderPath, const GLuint ShaderID)
+// Written at the start of every cached program binary file
+#define PROGRAM_CACHE_MAGIC 0x4d5a5342	// "MZSB"
+
+int ReadShaderFile(const char *ShaderPath, std::string &ShaderCode)
 {
-	// Read shader code from file
-	std::string ShaderCode;
+	// Read the whole shader file in one go
 	std::ifstream ShaderStream (ShaderPath, std::ios::in);
 	if (ShaderStream.is_open()) {
-		std::string Line = "";
-		while (getline(ShaderStream, Line)) {
-			ShaderCode += "\n" + Line;
-		}
+		std::stringstream Buffer;
+		Buffer << ShaderStream.rdbuf();
+		ShaderCode = Buffer.str();
 		ShaderStream.close();
 	}
 	else {
 		std::cerr << "Cannot open " << ShaderPath << ". Are you in the right directory?" << std::endl;
 		return 0;
 	}
+	return 1;
+}
 
-	// Compile Shader
-	char const *SourcePointer = ShaderCode.c_str();
-	glShaderSource(ShaderID, 1, &SourcePointer , NULL);
-	glCompileShader(ShaderID);
+void InsertDefines(std::string &ShaderCode, const char *Defines)
+{
+	// #version must stay first, so the defines go on the line after it
+	size_t VersionPos = ShaderCode.find("#version");
+	size_t InsertPos = 0;
+	if (VersionPos != std::string::npos) {
+		InsertPos = ShaderCode.find('\n', VersionPos);
+		InsertPos = (InsertPos == std::string::npos) ? ShaderCode.size() : InsertPos + 1;
+	}
+	ShaderCode.insert(InsertPos, Defines);
+}
 
+int CheckShader(const GLuint ShaderID)
+{
 	// Check Shader
 	GLint Result = GL_FALSE;
 	int InfoLogLength;
@@ -49,41 +65,238 @@ int CompileShader(const char *ShaderPath, const GLuint ShaderID)
 	return 1;
 }
 
-GLuint LoadShaders(const char * vertex_file_path,
-				   const char * fragment_file_path )
+/**************************************************
+ * Program binary cache.
+ * Linked programs are saved with glGetProgramBinary, in a file named after
+ * a hash of both shader sources and the driver (vendor, renderer, version).
+ * Any change to the shaders or the driver gives a new name, so a stale
+ * binary is never loaded.
+**************************************************/
+
+// 64 bit FNV-1a hash, continuing from Hash
+unsigned long long HashString(const std::string &Text, unsigned long long Hash)
 {
-	// Create the shaders
-	GLuint VertexShaderID = glCreateShader(GL_VERTEX_SHADER);
-	GLuint FragmentShaderID = glCreateShader(GL_FRAGMENT_SHADER);
+	for (size_t i = 0; i < Text.size(); i++) {
+		Hash ^= (unsigned char)Text[i];
+		Hash *= 1099511628211ULL;
+	}
+	return Hash;
+}
+
+std::string ProgramCachePath(const std::string &VertexShaderCode,
+							 const std::string &FragmentShaderCode)
+{
+	// $XDG_CACHE_HOME/maze, or ~/.cache/maze
+	std::string CacheDir;
+	if (getenv("XDG_CACHE_HOME") != NULL) {
+		CacheDir = getenv("XDG_CACHE_HOME");
+	} else if (getenv("HOME") != NULL) {
+		CacheDir = std::string(getenv("HOME")) + "/.cache";
+	} else {
+		return "";
+	}
+	mkdir(CacheDir.c_str(), 0755);
+	CacheDir += "/maze";
+	mkdir(CacheDir.c_str(), 0755);
+
+	unsigned long long Hash = 14695981039346656037ULL;
+	Hash = HashString(VertexShaderCode, Hash);
+	Hash = HashString(FragmentShaderCode, Hash);
+	Hash = HashString((const char *)glGetString(GL_VENDOR), Hash);
+	Hash = HashString((const char *)glGetString(GL_RENDERER), Hash);
+	Hash = HashString((const char *)glGetString(GL_VERSION), Hash);
 
-	// Compile both shaders. Exit if compile errors.
-	if ( !CompileShader(vertex_file_path, VertexShaderID)
-		 || !CompileShader(fragment_file_path, FragmentShaderID) ) {
+	char Name[32];
+	snprintf(Name, sizeof(Name), "/%016llx.bin", Hash);
+	return CacheDir + Name;
+}
+
+// Returns a linked program from the cache, or 0 if there is no usable binary
+GLuint LoadCachedProgram(const std::string &CachePath)
+{
+	FILE *CacheFile = fopen(CachePath.c_str(), "rb");
+	if (CacheFile == NULL) {
 		return 0;
 	}
-	
-	// Link the program
+
+	unsigned int Header[3];	// magic, binary format, binary length
+	std::vector<char> Binary;
+	bool Valid = fread(Header, sizeof(Header), 1, CacheFile) == 1
+		&& Header[0] == PROGRAM_CACHE_MAGIC;
+	if (Valid) {
+		Binary.resize(Header[2]);
+		Valid = Header[2] > 0 && fread(&Binary[0], 1, Header[2], CacheFile) == Header[2];
+	}
+	fclose(CacheFile);
+	if (!Valid) {
+		return 0;
+	}
+
+	// The driver can still reject a binary, e.g. after an update with the same version string
 	GLuint ProgramID = glCreateProgram();
-	glAttachShader(ProgramID, VertexShaderID);
-	glAttachShader(ProgramID, FragmentShaderID);
-	glLinkProgram(ProgramID);
+	glProgramBinary(ProgramID, Header[1], &Binary[0], Header[2]);
+
+	GLint Result = GL_FALSE;
+	glGetProgramiv(ProgramID, GL_LINK_STATUS, &Result);
+	if (Result != GL_TRUE) {
+		glDeleteProgram(ProgramID);
+		return 0;
+	}
+	return ProgramID;
+}
+
+void SaveProgramBinary(const GLuint ProgramID, const std::string &CachePath)
+{
+	GLint Length = 0;
+	glGetProgramiv(ProgramID, GL_PROGRAM_BINARY_LENGTH, &Length);
+	if (Length <= 0) {
+		return;
+	}
+
+	std::vector<char> Binary(Length);
+	GLenum Format;
+	glGetProgramBinary(ProgramID, Length, NULL, &Format, &Binary[0]);
+
+	// Write to a temporary file first, so a partly written cache is never read
+	std::string TempPath = CachePath + ".tmp";
+	FILE *CacheFile = fopen(TempPath.c_str(), "wb");
+	if (CacheFile == NULL) {
+		return;
+	}
+	unsigned int Header[3] = { PROGRAM_CACHE_MAGIC, Format, (unsigned int)Length };
+	bool Written = fwrite(Header, sizeof(Header), 1, CacheFile) == 1
+		&& fwrite(&Binary[0], 1, Length, CacheFile) == (size_t)Length;
+	fclose(CacheFile);
+
+	if (Written) {
+		rename(TempPath.c_str(), CachePath.c_str());
+	} else {
+		remove(TempPath.c_str());
+	}
+}
+
+GLuint LoadShaders(const char * vertex_file_path,
+				   const char * fragment_file_path,
+				   const char * defines )
+{
+	ShaderBuild Build;
+	if ( !BeginShaders(vertex_file_path, fragment_file_path, defines, Build) ) {
+		return 0;
+	}
+	return FinishShaders(Build);
+}
+
+bool BeginShaders(const char * vertex_file_path,
+				  const char * fragment_file_path,
+				  const char * defines,
+				  ShaderBuild &Build)
+{
+	Build.ProgramID = 0;
+	Build.VertexShaderID = 0;
+	Build.FragmentShaderID = 0;
+	Build.CachePath.clear();
+
+	std::string VertexShaderCode, FragmentShaderCode;
+	if ( !ReadShaderFile(vertex_file_path, VertexShaderCode)
+		 || !ReadShaderFile(fragment_file_path, FragmentShaderCode) ) {
+		return false;
+	}
+
+	// The defines become part of the source, so each variant is cached separately
+	if (defines != NULL) {
+		InsertDefines(VertexShaderCode, defines);
+		InsertDefines(FragmentShaderCode, defines);
+	}
+
+	// Use the cached program binary if this driver has already linked these shaders
+	bool UseCache = GLEW_ARB_get_program_binary;
+	if (UseCache) {
+		Build.CachePath = ProgramCachePath(VertexShaderCode, FragmentShaderCode);
+		GLuint CachedProgramID = Build.CachePath.empty() ? 0 : LoadCachedProgram(Build.CachePath);
+		if (CachedProgramID != 0) {
+			printf("loaded shader program from %s\n", Build.CachePath.c_str());
+			Build.ProgramID = CachedProgramID;
+			Build.CachePath.clear();
+			return true;
+		}
+	}
+
+	// Let the driver compile on as many threads as it likes
+	if (GLEW_KHR_parallel_shader_compile) {
+		glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+	}
+
+	// Create the shaders
+	Build.VertexShaderID = glCreateShader(GL_VERTEX_SHADER);
+	Build.FragmentShaderID = glCreateShader(GL_FRAGMENT_SHADER);
+
+	char const *VertexSourcePointer = VertexShaderCode.c_str();
+	char const *FragmentSourcePointer = FragmentShaderCode.c_str();
+	glShaderSource(Build.VertexShaderID, 1, &VertexSourcePointer, NULL);
+	glShaderSource(Build.FragmentShaderID, 1, &FragmentSourcePointer, NULL);
+	glCompileShader(Build.VertexShaderID);
+	glCompileShader(Build.FragmentShaderID);
+
+	// Link straight away without waiting for the compiles, a failed compile
+	// fails the link and is reported by FinishShaders
+	Build.ProgramID = glCreateProgram();
+	glAttachShader(Build.ProgramID, Build.VertexShaderID);
+	glAttachShader(Build.ProgramID, Build.FragmentShaderID);
+	if (UseCache) {
+		glProgramParameteri(Build.ProgramID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	}
+	glLinkProgram(Build.ProgramID);
+	return true;
+}
+
+bool ShaderBuildDone(const ShaderBuild &Build)
+{
+	if (Build.VertexShaderID == 0 || !GLEW_KHR_parallel_shader_compile) {
+		return true;
+	}
+
+	// Asking for the completion status never waits for the driver
+	GLint Completed = GL_FALSE;
+	glGetProgramiv(Build.ProgramID, GL_COMPLETION_STATUS_KHR, &Completed);
+	return Completed == GL_TRUE;
+}
+
+GLuint FinishShaders(ShaderBuild &Build)
+{
+	if (Build.VertexShaderID == 0) {
+		return Build.ProgramID;
+	}
+
+	// Exit if compile errors.
+	bool Compiled = CheckShader(Build.VertexShaderID) && CheckShader(Build.FragmentShaderID);
 
 	// Check the program
 	GLint Result = GL_FALSE;
 	int InfoLogLength;
 	
-	glGetProgramiv(ProgramID, GL_LINK_STATUS, &Result);
-	glGetProgramiv(ProgramID, GL_INFO_LOG_LENGTH, &InfoLogLength);
-	if ( InfoLogLength > 0 ) {
+	glGetProgramiv(Build.ProgramID, GL_LINK_STATUS, &Result);
+	glGetProgramiv(Build.ProgramID, GL_INFO_LOG_LENGTH, &InfoLogLength);
+	if ( Compiled && InfoLogLength > 0 ) {
 		std::vector<char> ProgramErrorMessage(InfoLogLength+1);
-		glGetProgramInfoLog(ProgramID, InfoLogLength, NULL, &ProgramErrorMessage[0]);
+		glGetProgramInfoLog(Build.ProgramID, InfoLogLength, NULL, &ProgramErrorMessage[0]);
 		std::cerr << &ProgramErrorMessage[0] << std::endl;
 	}
 
-	glDeleteShader(VertexShaderID);
-	glDeleteShader(FragmentShaderID);
+	glDetachShader(Build.ProgramID, Build.VertexShaderID);
+	glDetachShader(Build.ProgramID, Build.FragmentShaderID);
+	glDeleteShader(Build.VertexShaderID);
+	glDeleteShader(Build.FragmentShaderID);
+	Build.VertexShaderID = 0;
+	Build.FragmentShaderID = 0;
 
-	return ProgramID;
-}
+	if (!Compiled) {
+		glDeleteProgram(Build.ProgramID);
+		return 0;
+	}
 
+	if (Result == GL_TRUE && !Build.CachePath.empty()) {
+		SaveProgramBinary(Build.ProgramID, Build.CachePath);
+	}
 
+	return Build.ProgramID;
+}
@@ -1,14 +1,47 @@
 #ifndef SHADER_HPP
 #define SHADER_HPP
 
+#include <string>
+
 /**************************************************
  * Simple function to read GLSL shader source from a file,
  * Then compile it and link to create a shader program ready for use.
+ * Linked programs are cached on disk (~/.cache/maze) and reused
+ * while the shader sources and driver are unchanged.
+ * Optional defines (eg. "#define RENDER_STAGE 1\n") are inserted after the
+ * #version line of both shaders, to build variants of one source.
  * Returns the ID of the shader program (assigned by OpenGL)
  * or 0 if error.
 **************************************************/
 
 GLuint LoadShaders(const char * vertex_file_path,
-				   const char * fragment_file_path);
+				   const char * fragment_file_path,
+				   const char * defines = NULL);
+
+/**************************************************
+ * LoadShaders in steps, so several programs can be compiled and linked by
+ * the driver at once: begin every program, then finish each one when
+ * ShaderBuildDone says the driver is done with it. Without
+ * KHR_parallel_shader_compile the driver may still do the work in
+ * FinishShaders, and ShaderBuildDone is always true.
+**************************************************/
+
+// A program being compiled and linked, or loaded from the cache
+struct ShaderBuild {
+	GLuint ProgramID;
+	GLuint VertexShaderID, FragmentShaderID;	// 0 if the program came from the cache
+	std::string CachePath;	// where to save the linked program, empty to not save it
+};
+
+// Returns false if the shader files couldn't be read
+bool BeginShaders(const char * vertex_file_path,
+				  const char * fragment_file_path,
+				  const char * defines,
+				  ShaderBuild &Build);
+
+bool ShaderBuildDone(const ShaderBuild &Build);
+
+// Returns the ID of the shader program or 0 if error
+GLuint FinishShaders(ShaderBuild &Build);
 
 #endif
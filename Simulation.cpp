@@ -0,0 +1,182 @@
+#include "Simulation.h"
+
+#include <chrono>
+
+// Set in middleSnapshot when it holds a snapshot the renderer hasn't read
+#define SNAPSHOT_FRESH 4
+#define SNAPSHOT_INDEX_MASK 3
+
+/**
+ * Create the game and camera. The simulation doesn't run until start() is called.
+ * @param maze Maze to move the ball in
+ * @param cameraEye Initial camera position
+ */
+Simulation::Simulation(Maze *maze, glm::vec3 cameraEye):
+	maze(maze),
+	backSnapshot(0),
+	middleSnapshot(1),
+	frontSnapshot(2),
+	running(false) {
+
+	gameManager = new GameManager(maze);
+	camera = new ObjectViewer(cameraEye);
+
+	// Every buffer starts with the initial state
+	for (int i = 0; i < 3; i++) {
+		snapshots[i].ballX = maze->ballX;
+		snapshots[i].ballY = maze->ballY;
+		snapshots[i].view = camera->getViewMtx();
+	}
+}
+
+Simulation::~Simulation() {
+	stop();
+
+	delete camera;
+	delete gameManager;
+}
+
+/**
+ * Queue an input event for the next step. Only call from one thread.
+ * @return false if the queue is full and the event was dropped
+ */
+bool Simulation::post(InputEvent event) {
+	return inputQueue.push(event);
+}
+
+/**
+ * Apply one input event to the game or camera
+ * @return true if a new snapshot should be published
+ */
+bool Simulation::applyEvent(InputEvent &event) {
+	switch (event.type) {
+		case INPUT_EVENT_KEY:
+			return gameManager->moveBall(event.key, camera->getCameraRotation());
+		case INPUT_EVENT_MOUSE_MOVE:
+			input.update(event.x);
+			return false;
+		case INPUT_EVENT_MOUSE_BUTTON:
+			input.lMousePressed = event.pressed;
+			return false;
+		case INPUT_EVENT_REDRAW:
+			return true;
+		case INPUT_EVENT_HINT:
+			gameManager->showHint(camera->getCameraRotation());
+			return false;
+		case INPUT_EVENT_RELOADED:
+			gameManager->mazeReloaded();
+			return true;
+		default:
+			return false;
+	}
+}
+
+/**
+ * Advance the simulation: apply all queued input, then publish a snapshot
+ * if anything changed. Mouse movement is accumulated by InputState, so the
+ * camera turns once per step.
+ */
+void Simulation::step() {
+	bool changed = false;
+
+	InputEvent event;
+	while (inputQueue.pop(event)) {
+		changed |= applyEvent(event);
+	}
+
+	changed |= camera->update(input);
+
+	if (changed) {
+		publish();
+	}
+}
+
+/**
+ * Make the current state available to the renderer
+ */
+void Simulation::publish() {
+	FrameSnapshot &snapshot = snapshots[backSnapshot];
+	{
+		std::lock_guard<std::mutex> lock(maze->worldMutex);
+		snapshot.ballX = maze->ballX;
+		snapshot.ballY = maze->ballY;
+	}
+	snapshot.view = camera->getViewMtx();
+
+	backSnapshot = middleSnapshot.exchange(backSnapshot | SNAPSHOT_FRESH) & SNAPSHOT_INDEX_MASK;
+
+	// Take the lock so a renderer that just found nothing fresh is already waiting
+	{
+		std::lock_guard<std::mutex> lock(publishMutex);
+	}
+	published.notify_one();
+}
+
+/**
+ * Get the latest published state. Only call from one thread.
+ * @param snapshot Filled with the latest snapshot
+ * @return true if it is newer than the one returned last time
+ */
+bool Simulation::readSnapshot(FrameSnapshot &snapshot) {
+	bool fresh = false;
+
+	if (middleSnapshot.load() & SNAPSHOT_FRESH) {
+		frontSnapshot = middleSnapshot.exchange(frontSnapshot) & SNAPSHOT_INDEX_MASK;
+		fresh = true;
+	}
+
+	snapshot = snapshots[frontSnapshot];
+	return fresh;
+}
+
+/**
+ * Sleep until there is a snapshot the renderer hasn't read. Only call from the renderer.
+ * @param seconds Longest time to wait
+ * @return true if there is a fresh snapshot, false if the wait timed out
+ */
+bool Simulation::waitForSnapshot(double seconds) {
+	std::unique_lock<std::mutex> lock(publishMutex);
+	return published.wait_for(lock, std::chrono::duration<double>(seconds), [this] {
+		return (middleSnapshot.load() & SNAPSHOT_FRESH) != 0;
+	});
+}
+
+/**
+ * Step at a fixed rate until stopped
+ * Steps are scheduled from the start time, so a late step doesn't slow the rate.
+ */
+void Simulation::run() {
+	std::chrono::steady_clock::duration stepLength = 
+		std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+			std::chrono::duration<double>(1.0 / SIMULATION_HZ));
+	std::chrono::steady_clock::time_point nextStep = std::chrono::steady_clock::now();
+
+	while (running) {
+		step();
+
+		nextStep += stepLength;
+		std::this_thread::sleep_until(nextStep);
+	}
+}
+
+/**
+ * Run the simulation on its own thread
+ */
+void Simulation::start() {
+	if (running) {
+		return;
+	}
+
+	running = true;
+	thread = std::thread(&Simulation::run, this);
+}
+
+/**
+ * Stop the simulation thread and wait for it to finish
+ */
+void Simulation::stop() {
+	running = false;
+	if (thread.joinable()) {
+		thread.join();
+	}
+}
@@ -0,0 +1,91 @@
+/**
+ * Game simulation, run at a fixed rate on its own thread.
+ * Owns the game logic and camera. Input events arrive through a lock-free
+ * queue, and the result of each step is published as a snapshot that the
+ * render thread can read at any time without locking.
+ */
+
+#ifndef SIMULATION_H
+#define SIMULATION_H
+
+#include "GameManager.h"
+#include "InputState.h"
+#include "Maze.h"
+#include "SpscQueue.h"
+#include "Viewer.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "glm/glm.hpp"
+
+// Simulation steps per second
+#define SIMULATION_HZ 120
+// Input events that can wait between two steps
+#define INPUT_QUEUE_SIZE 256
+
+// Kinds of input event
+#define INPUT_EVENT_KEY 0
+#define INPUT_EVENT_MOUSE_MOVE 1
+#define INPUT_EVENT_MOUSE_BUTTON 2
+#define INPUT_EVENT_REDRAW 3		// publish a snapshot even if nothing changed
+#define INPUT_EVENT_HINT 4			// print the best next move
+#define INPUT_EVENT_RELOADED 5		// the maze was replaced, check the ball and publish it
+
+struct InputEvent {
+	int type;
+	int key;		// GLFW key for INPUT_EVENT_KEY
+	float x;		// cursor x for INPUT_EVENT_MOUSE_MOVE
+	bool pressed;	// left button state for INPUT_EVENT_MOUSE_BUTTON
+};
+
+// Everything the renderer needs from one simulation step
+struct FrameSnapshot {
+	int ballX, ballY;
+	glm::mat4 view;
+};
+
+class Simulation {
+private:
+	Maze *maze;
+	GameManager *gameManager;
+	ObjectViewer *camera;
+	InputState input;
+
+	SpscQueue<InputEvent, INPUT_QUEUE_SIZE> inputQueue;
+
+	// Triple buffer: the simulation writes the back snapshot while the renderer
+	// reads the front one. They are swapped through the middle one.
+	FrameSnapshot snapshots[3];
+	int backSnapshot;
+	std::atomic<int> middleSnapshot;
+	int frontSnapshot;
+
+	// Lets the renderer sleep until a snapshot is published
+	std::mutex publishMutex;
+	std::condition_variable published;
+
+	std::thread thread;
+	std::atomic<bool> running;
+
+	bool applyEvent(InputEvent &event);
+	void publish();
+	void run();
+
+public:
+	Simulation(Maze *maze, glm::vec3 cameraEye);
+	~Simulation();
+
+	bool post(InputEvent event);
+	void step();
+
+	void start();
+	void stop();
+
+	bool readSnapshot(FrameSnapshot &snapshot);
+	bool waitForSnapshot(double seconds);
+};
+
+#endif
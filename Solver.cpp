@@ -0,0 +1,856 @@
+#include "Direction.h"
+#include "Solver.h"
+
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <cstdlib>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <stdint.h>
+#include <thread>
+
+const char *solverNames[SOLVER_COUNT] = { "bfs", "parallel-bfs", "astar", "bidirectional" };
+
+// Threads used by SOLVER_PARALLEL_BFS, 0 for one per core
+int solverThreads = 0;
+
+/**
+ * @return true if a square is inside the maze and not a block
+ */
+static bool isFree(const MazeGrid &grid, int row, int col) {
+	return row >= 0 && row < grid.size() && col >= 0 && col < grid.size() && !grid.isBlock(row, col);
+}
+
+/**
+ * Search one move further backwards from the goal
+ * A square the ball stops in when moving in a direction can be reached in
+ * that direction from every square behind it, up to a block or the edge.
+ * Each of those squares not visited before is one move further from the
+ * goal than the frontier, and its first move is that direction.
+ * @param grid Maze being searched
+ * @param frontier Squares found by the last move, taken out as they are searched from
+ * @param visited Bitmap of the squares found so far, updated
+ * @param next Set to the squares found by this move
+ * @param firstMoves Direction of the first move from each square found, 2 bits
+ *	per square, or NULL if it isn't needed
+ * @return Number of squares searched from
+ */
+long searchBackwards(const MazeGrid &grid, SquareBitmap &frontier, std::vector<uint64_t> &visited, 
+	SquareBitmap &next, uint64_t *firstMoves) {
+	int size = grid.size();
+	long expanded = 0;
+
+	for (long square = frontier.takeNext(); square != -1; square = frontier.takeNext()) {
+		int row = square / size;
+		int col = square % size;
+		expanded++;
+
+		for (int direction = 0; direction < DIRECTION_COUNT; direction++) {
+			int rowStep = directionRowSteps[direction];
+			int colStep = directionColSteps[direction];
+
+			// The ball only stops here moving this way in front of a block or the edge
+			if (isFree(grid, row + rowStep, col + colStep)) {
+				continue;
+			}
+
+			// Every free square behind it, up to where a slide the other way stops
+			int endRow = row;
+			int endCol = col;
+			grid.slide((direction + 2) % DIRECTION_COUNT, endRow, endCol);
+			if (endRow == row && endCol == col) {
+				continue;
+			}
+
+			// Along a row they are next to each other in the bitmaps, so a word is done at a time
+			if (rowStep == 0) {
+				long first = (long)row * size + std::min(col - colStep, endCol);
+				long last = (long)row * size + std::max(col - colStep, endCol);
+				for (long word = first >> 6; word <= last >> 6; word++) {
+					uint64_t behind = ~0ull;
+					if (word == first >> 6) {
+						behind &= ~0ull << (first & 63);
+					}
+					if (word == last >> 6) {
+						behind &= ~0ull >> (63 - (last & 63));
+					}
+					uint64_t found = behind & ~visited[word];
+					visited[word] |= found;
+					next.addWord(word, found);
+					for (; firstMoves != NULL && found != 0; found &= found - 1) {
+						long from = word*64 + __builtin_ctzll(found);
+						firstMoves[from >> 5] |= (uint64_t)direction << ((from & 31) * 2);
+					}
+				}
+				continue;
+			}
+
+			for (long from = square - (long)rowStep * size, end = (long)endRow * size + endCol; ; from -= (long)rowStep * size) {
+				if (((visited[from >> 6] >> (from & 63)) & 1) == 0) {
+					visited[from >> 6] |= 1ull << (from & 63);
+					if (firstMoves != NULL) {
+						firstMoves[from >> 5] |= (uint64_t)direction << ((from & 31) * 2);
+					}
+					next.add(from);
+				}
+				if (from == end) {
+					break;
+				}
+			}
+		}
+	}
+	return expanded;
+}
+
+/**
+ * Breadth first search backwards from the goal, one searchBackwards() per move
+ * The squares found in each move are kept as bitmaps, so memory doesn't grow
+ * with how many there are.
+ */
+static bool solveBfs(const MazeGrid &grid, Solution &solution) {
+	int size = grid.size();
+	long squares = (long)size * size;
+	long start = (long)grid.getStartRow() * size + grid.getStartCol();
+	long goal = (long)grid.getGoalRow() * size + grid.getGoalCol();
+
+	// 1 bit per square, and 2 bits for the first move
+	std::vector<uint64_t> visited((squares + 63) / 64, 0);
+	std::vector<uint64_t> firstMoves((squares + 31) / 32, 0);
+
+	SquareBitmap frontier(squares);
+	SquareBitmap next(squares);
+	frontier.add(goal);
+	visited[goal >> 6] |= 1ull << (goal & 63);
+
+	while (!frontier.empty() && ((visited[start >> 6] >> (start & 63)) & 1) == 0) {
+		solution.statesExpanded += searchBackwards(grid, frontier, visited, next, firstMoves.data());
+		std::swap(frontier, next);
+	}
+
+	if (((visited[start >> 6] >> (start & 63)) & 1) == 0) {
+		return false;
+	}
+
+	int row = grid.getStartRow();
+	int col = grid.getStartCol();
+	while ((long)row * size + col != goal) {
+		long square = (long)row * size + col;
+		int direction = (firstMoves[square >> 5] >> ((square & 31) * 2)) & 3;
+		solution.moves.push_back(direction);
+		grid.slide(direction, row, col);
+	}
+	return true;
+}
+
+/**
+ * Lets a group of threads wait for each other between steps
+ */
+class Barrier {
+private:
+	std::mutex mutex;
+	std::condition_variable released;
+	int threadCount, waiting;
+	long generation;
+
+public:
+	Barrier(int threadCount): threadCount(threadCount), waiting(0), generation(0) {
+	}
+
+	void wait() {
+		std::unique_lock<std::mutex> lock(mutex);
+		long arrived = generation;
+		if (++waiting == threadCount) {
+			waiting = 0;
+			generation++;
+			released.notify_all();
+		} else {
+			released.wait(lock, [this, arrived]() { return generation != arrived; });
+		}
+	}
+};
+
+/**
+ * State shared by the threads of SOLVER_PARALLEL_BFS
+ * Every thread runs work() in step with the others. The squares found in
+ * the last move and the ones being found now are bitmaps, each with a
+ * summary bit for every word that has any set, so no thread has to gather
+ * lists of squares between moves. The first thread only adds up counts and
+ * swaps the bitmaps over.
+ */
+class ParallelBfs {
+private:
+	const MazeGrid &grid;
+	int size;
+	long squares;
+	int threadCount;
+	Barrier barrier;
+
+	std::vector<std::atomic<uint64_t>> visited;
+	std::vector<std::atomic<uint64_t>> firstMoves;	// 2 bits per square
+	std::vector<std::atomic<uint64_t>> frontierBits, frontierSummary;
+	std::vector<std::atomic<uint64_t>> nextBits, nextSummary;
+	std::atomic<long> nextChunk;	// first summary word of the frontier not yet taken top down
+
+	// By each thread, in the current move
+	std::vector<long> found;
+	std::vector<long> walked;	// squares stepped over searching top down
+	std::vector<long> expanded;	// over the whole search
+
+	long frontierSize;
+	long unvisited;
+	long freeSquares;
+	bool bottomUp;
+	bool done;
+	long start;
+
+	bool claim(long square, int direction);
+	void addNext(long square);
+	void searchTopDown(int thread);
+	void searchBottomUp(int thread);
+	void clearFrontier(int thread);
+	void finishMove();
+
+public:
+	ParallelBfs(const MazeGrid &grid, int threadCount);
+	void work(int thread);
+	bool readMoves(Solution &solution);
+};
+
+/**
+ * Fill a vector of atomic words with 0
+ */
+static void clearWords(std::vector<std::atomic<uint64_t>> &words) {
+	for (long i = 0; i < words.size(); i++) {
+		words[i].store(0, std::memory_order_relaxed);
+	}
+}
+
+ParallelBfs::ParallelBfs(const MazeGrid &grid, int threadCount):
+	grid(grid),
+	size(grid.size()),
+	squares((long)grid.size() * grid.size()),
+	threadCount(threadCount),
+	barrier(threadCount),
+	visited((squares + 63) / 64),
+	firstMoves((squares + 31) / 32),
+	frontierBits((squares + 63) / 64),
+	frontierSummary(((squares + 63) / 64 + 63) / 64),
+	nextBits((squares + 63) / 64),
+	nextSummary(((squares + 63) / 64 + 63) / 64),
+	nextChunk(0),
+	found(threadCount, 0),
+	walked(threadCount, 0),
+	expanded(threadCount, 0),
+	frontierSize(1),
+	bottomUp(false),
+	done(false) {
+
+	clearWords(visited);
+	clearWords(firstMoves);
+	clearWords(frontierBits);
+	clearWords(frontierSummary);
+	clearWords(nextBits);
+	clearWords(nextSummary);
+
+	start = (long)grid.getStartRow() * size + grid.getStartCol();
+	long goal = (long)grid.getGoalRow() * size + grid.getGoalCol();
+	visited[goal >> 6].store(1ull << (goal & 63));
+	frontierBits[goal >> 6].store(1ull << (goal & 63));
+	frontierSummary[goal >> 12].store(1ull << ((goal >> 6) & 63));
+
+	freeSquares = squares - grid.countBlocks();
+	unvisited = freeSquares - 1;
+	done = start == goal;
+}
+
+/**
+ * Mark a square visited, if no other thread got there first
+ * @param direction First move from the square
+ * @return true if this thread claimed it
+ */
+bool ParallelBfs::claim(long square, int direction) {
+	uint64_t bit = 1ull << (square & 63);
+	if ((visited[square >> 6].load(std::memory_order_relaxed) & bit) != 0 || 
+		(visited[square >> 6].fetch_or(bit) & bit) != 0) {
+		return false;
+	}
+	firstMoves[square >> 5].fetch_or((uint64_t)direction << ((square & 31) * 2), std::memory_order_relaxed);
+	return true;
+}
+
+/**
+ * Add a square this thread claimed to the next frontier
+ */
+void ParallelBfs::addNext(long square) {
+	if (nextBits[square >> 6].fetch_or(1ull << (square & 63), std::memory_order_relaxed) == 0) {
+		nextSummary[square >> 12].fetch_or(1ull << ((square >> 6) & 63), std::memory_order_relaxed);
+	}
+}
+
+/**
+ * Search backwards from the frontier, as SOLVER_BFS does
+ * Threads take SOLVER_TOP_DOWN_CHUNK summary words of the frontier at a
+ * time, so a thread that finds a busy part of the maze doesn't hold up
+ * the others, and clear the frontier as they go.
+ */
+void ParallelBfs::searchTopDown(int thread) {
+	long threadFound = 0;
+	long threadWalked = 0;
+	long threadExpanded = 0;
+
+	long summaryWords = frontierSummary.size();
+	for (long first = nextChunk.fetch_add(SOLVER_TOP_DOWN_CHUNK); first < summaryWords; 
+		first = nextChunk.fetch_add(SOLVER_TOP_DOWN_CHUNK)) {
+
+		long last = std::min(first + SOLVER_TOP_DOWN_CHUNK, summaryWords);
+		for (long summaryWord = first; summaryWord < last; summaryWord++) {
+			uint64_t setWords = frontierSummary[summaryWord].exchange(0, std::memory_order_relaxed);
+			for (; setWords != 0; setWords &= setWords - 1) {
+				long word = summaryWord*64 + __builtin_ctzll(setWords);
+				uint64_t bits = frontierBits[word].exchange(0, std::memory_order_relaxed);
+
+				for (; bits != 0; bits &= bits - 1) {
+					long square = word*64 + __builtin_ctzll(bits);
+					int row = square / size;
+					int col = square % size;
+					threadExpanded++;
+
+					for (int direction = 0; direction < DIRECTION_COUNT; direction++) {
+						int rowStep = directionRowSteps[direction];
+						int colStep = directionColSteps[direction];
+						if (isFree(grid, row + rowStep, col + colStep)) {
+							continue;
+						}
+
+						for (int fromRow = row - rowStep, fromCol = col - colStep; isFree(grid, fromRow, fromCol); 
+							fromRow -= rowStep, fromCol -= colStep) {
+
+							long from = (long)fromRow * size + fromCol;
+							threadWalked++;
+							if (claim(from, direction)) {
+								addNext(from);
+								threadFound++;
+							}
+						}
+					}
+				}
+			}
+		}
+	}
+
+	found[thread] = threadFound;
+	walked[thread] = threadWalked;
+	expanded[thread] += threadExpanded;
+}
+
+/**
+ * Check each unvisited square in this thread's share of the maze for a move
+ * that stops in the frontier
+ * Shares are whole words of the visited bitmap, so no other thread claims
+ * squares in them.
+ */
+void ParallelBfs::searchBottomUp(int thread) {
+	long firstWord = (long)visited.size() * thread / threadCount;
+	long lastWord = (long)visited.size() * (thread + 1) / threadCount;
+	long threadFound = 0;
+	long threadExpanded = 0;
+
+	for (long word = firstWord; word < lastWord; word++) {
+		uint64_t unvisitedBits = ~visited[word].load(std::memory_order_relaxed);
+		for (; unvisitedBits != 0; unvisitedBits &= unvisitedBits - 1) {
+			long square = word*64 + __builtin_ctzll(unvisitedBits);
+			if (square >= squares) {
+				break;
+			}
+			int row = square / size;
+			int col = square % size;
+			if (grid.isBlock(row, col)) {
+				continue;
+			}
+			threadExpanded++;
+
+			for (int direction = 0; direction < DIRECTION_COUNT; direction++) {
+				int stopRow = row;
+				int stopCol = col;
+				grid.slide(direction, stopRow, stopCol);
+				long stop = (long)stopRow * size + stopCol;
+				if ((frontierBits[stop >> 6].load(std::memory_order_relaxed) >> (stop & 63)) & 1) {
+					if (claim(square, direction)) {
+						addNext(square);
+						threadFound++;
+					}
+					break;
+				}
+			}
+		}
+	}
+
+	found[thread] = threadFound;
+	walked[thread] = 0;
+	expanded[thread] += threadExpanded;
+}
+
+/**
+ * Clear this thread's share of the frontier, once searching bottom up is done with it
+ */
+void ParallelBfs::clearFrontier(int thread) {
+	long first = (long)frontierSummary.size() * thread / threadCount;
+	long last = (long)frontierSummary.size() * (thread + 1) / threadCount;
+
+	for (long summaryWord = first; summaryWord < last; summaryWord++) {
+		uint64_t setWords = frontierSummary[summaryWord].exchange(0, std::memory_order_relaxed);
+		for (; setWords != 0; setWords &= setWords - 1) {
+			frontierBits[summaryWord*64 + __builtin_ctzll(setWords)].store(0, std::memory_order_relaxed);
+		}
+	}
+}
+
+/**
+ * Make the squares found in this move the frontier, and choose how to
+ * search from it. First thread only, while the others wait.
+ */
+void ParallelBfs::finishMove() {
+	long expandedSquares = frontierSize;
+	long walkedSquares = 0;
+	frontierSize = 0;
+	for (int thread = 0; thread < threadCount; thread++) {
+		frontierSize += found[thread];
+		walkedSquares += walked[thread];
+	}
+	unvisited -= frontierSize;
+
+	// Both frontier bitmaps are clear now but for the squares just found
+	frontierBits.swap(nextBits);
+	frontierSummary.swap(nextSummary);
+	nextChunk.store(0, std::memory_order_relaxed);
+
+	// Top down costs the squares behind each frontier square, which only the
+	// last top down move can estimate. Bottom up costs up to four slides
+	// from every unvisited square.
+	if (!bottomUp && expandedSquares > 0) {
+		double topDownWork = (double)walkedSquares / expandedSquares * frontierSize;
+		bottomUp = topDownWork > (double)unvisited * SOLVER_BOTTOM_UP_ALPHA;
+	} else if (bottomUp && frontierSize < freeSquares / SOLVER_BOTTOM_UP_BETA) {
+		bottomUp = false;
+	}
+
+	done = frontierSize == 0 || ((visited[start >> 6].load() >> (start & 63)) & 1);
+}
+
+/**
+ * Search one move at a time until the start is reached or there is nothing left to search
+ * @param thread Index of the calling thread, from 0
+ */
+void ParallelBfs::work(int thread) {
+	while (true) {
+		barrier.wait();
+		if (done) {
+			return;
+		}
+
+		if (bottomUp) {
+			searchBottomUp(thread);
+			barrier.wait();
+			clearFrontier(thread);
+		} else {
+			searchTopDown(thread);
+		}
+		barrier.wait();
+
+		if (thread == 0) {
+			finishMove();
+		}
+	}
+}
+
+/**
+ * Read the moves off by sliding from the start
+ * @return true if the start was reached
+ */
+bool ParallelBfs::readMoves(Solution &solution) {
+	for (int thread = 0; thread < threadCount; thread++) {
+		solution.statesExpanded += expanded[thread];
+	}
+
+	if (((visited[start >> 6].load() >> (start & 63)) & 1) == 0) {
+		return false;
+	}
+
+	int row = grid.getStartRow();
+	int col = grid.getStartCol();
+	while (row != grid.getGoalRow() || col != grid.getGoalCol()) {
+		long square = (long)row * size + col;
+		int direction = (firstMoves[square >> 5].load(std::memory_order_relaxed) >> ((square & 31) * 2)) & 3;
+		solution.moves.push_back(direction);
+		grid.slide(direction, row, col);
+	}
+	return true;
+}
+
+/**
+ * Breadth first search backwards from the goal, shared between threads
+ */
+static bool solveParallelBfs(const MazeGrid &grid, Solution &solution) {
+	int threadCount = solverThreads > 0 ? solverThreads : std::max(1, (int)std::thread::hardware_concurrency());
+	ParallelBfs search(grid, threadCount);
+
+	std::vector<std::thread> threads;
+	for (int thread = 1; thread < threadCount; thread++) {
+		threads.push_back(std::thread(&ParallelBfs::work, &search, thread));
+	}
+	search.work(0);
+	for (int i = 0; i < threads.size(); i++) {
+		threads[i].join();
+	}
+
+	return search.readMoves(solution);
+}
+
+/**
+ * A square reached by SOLVER_ASTAR or SOLVER_BIDIRECTIONAL
+ */
+struct SearchNode {
+	long next;		// square the move to this one came from, or going to the goal, -1 if none
+	int moves;		// from the start, or to the goal
+	int direction;	// of that move
+	bool expanded;
+};
+
+/**
+ * Squares reached by a search, in a hash table with linear probing
+ * Squares are never removed, which keeps it simpler and much faster than
+ * std::unordered_map. Pointers to nodes last until the next set().
+ */
+class ReachedSquares {
+private:
+	std::vector<long> squares;	// -1 in empty slots
+	std::vector<SearchNode> nodes;
+	int bits;
+	long count;
+
+	long findSlot(long square) const {
+		long mask = squares.size() - 1;
+		long slot = (long)(((uint64_t)square * 0x9e3779b97f4a7c15ull) >> (64 - bits));
+		while (squares[slot] != -1 && squares[slot] != square) {
+			slot = (slot + 1) & mask;
+		}
+		return slot;
+	}
+
+public:
+	ReachedSquares(): squares(1 << 10, -1), nodes(1 << 10), bits(10), count(0) {
+	}
+
+	/**
+	 * @return The square's node, or NULL if it hasn't been reached
+	 */
+	SearchNode *find(long square) {
+		long slot = findSlot(square);
+		return squares[slot] == -1 ? NULL : &nodes[slot];
+	}
+
+	/**
+	 * Add a square, or replace its node if it was already reached
+	 */
+	void set(long square, const SearchNode &node) {
+		// Grow at half full, so probes stay short
+		if (2 * (count + 1) > squares.size()) {
+			std::vector<long> oldSquares(squares.size() * 2, -1);
+			std::vector<SearchNode> oldNodes(nodes.size() * 2);
+			oldSquares.swap(squares);
+			oldNodes.swap(nodes);
+			bits++;
+			for (long i = 0; i < oldSquares.size(); i++) {
+				if (oldSquares[i] != -1) {
+					long slot = findSlot(oldSquares[i]);
+					squares[slot] = oldSquares[i];
+					nodes[slot] = oldNodes[i];
+				}
+			}
+		}
+
+		long slot = findSlot(square);
+		if (squares[slot] == -1) {
+			squares[slot] = square;
+			count++;
+		}
+		nodes[slot] = node;
+	}
+};
+
+/**
+ * Fewest moves from a square to the goal if nothing were in the way
+ * A move changes the row or the column but not both, so a square in neither
+ * the goal's row nor its column is at least 2 moves away. This never drops
+ * by more than 1 a move, so A* finds each square's fewest moves the first
+ * time it expands it.
+ */
+static int alignmentHeuristic(const MazeGrid &grid, int row, int col) {
+	if (row == grid.getGoalRow() && col == grid.getGoalCol()) {
+		return 0;
+	} else if (row == grid.getGoalRow() || col == grid.getGoalCol()) {
+		return 1;
+	}
+	return 2;
+}
+
+/**
+ * Add the moves from the start to a reached square to the solution
+ * @param reached Squares reached from the start
+ */
+static void addMovesFromStart(ReachedSquares &reached, long square, Solution &solution) {
+	size_t first = solution.moves.size();
+	for (SearchNode *node = reached.find(square); node->next != -1; node = reached.find(node->next)) {
+		solution.moves.push_back(node->direction);
+	}
+	std::reverse(solution.moves.begin() + first, solution.moves.end());
+}
+
+/**
+ * A* search forwards from the start
+ * Only the squares reached are stored, so a search that stays near the
+ * start uses little memory however big the maze is.
+ */
+static bool solveAStar(const MazeGrid &grid, Solution &solution) {
+	int size = grid.size();
+	long start = (long)grid.getStartRow() * size + grid.getStartCol();
+	long goal = (long)grid.getGoalRow() * size + grid.getGoalCol();
+
+	ReachedSquares reached;
+	SearchNode startNode = { -1, 0, 0, false };
+	reached.set(start, startNode);
+
+	// Squares to expand, by moves from the start plus the heuristic. The
+	// lowest never goes down, so the buckets are emptied in order. The last
+	// square added is expanded first, which follows one path deeper on ties.
+	std::vector<std::vector<long>> open(3);
+	open[alignmentHeuristic(grid, grid.getStartRow(), grid.getStartCol())].push_back(start);
+
+	for (int cost = 0; cost < open.size(); cost++) {
+		while (!open[cost].empty()) {
+			long square = open[cost].back();
+			open[cost].pop_back();
+
+			int row = square / size;
+			int col = square % size;
+			SearchNode *node = reached.find(square);
+			// Left behind when the square was reached again in fewer moves
+			if (node->expanded || node->moves + alignmentHeuristic(grid, row, col) != cost) {
+				continue;
+			}
+			node->expanded = true;
+			int moves = node->moves + 1;
+			solution.statesExpanded++;
+
+			if (square == goal) {
+				addMovesFromStart(reached, goal, solution);
+				return true;
+			}
+
+			for (int direction = 0; direction < DIRECTION_COUNT; direction++) {
+				int stopRow = row;
+				int stopCol = col;
+				grid.slide(direction, stopRow, stopCol);
+				long stop = (long)stopRow * size + stopCol;
+				if (stop == square) {
+					continue;
+				}
+
+				SearchNode *found = reached.find(stop);
+				if (found != NULL && (found->expanded || found->moves <= moves)) {
+					continue;
+				}
+				SearchNode stopNode = { square, moves, direction, false };
+				reached.set(stop, stopNode);
+
+				int stopCost = stopNode.moves + alignmentHeuristic(grid, stopRow, stopCol);
+				if (stopCost >= open.size()) {
+					open.resize(stopCost + 1);
+				}
+				open[stopCost].push_back(stop);
+			}
+		}
+	}
+	return false;
+}
+
+/**
+ * Breadth first search forwards from the start and backwards from the goal
+ * at once, one move at a time from whichever side has fewer squares to
+ * search from, until the two meet
+ */
+static bool solveBidirectional(const MazeGrid &grid, Solution &solution) {
+	int size = grid.size();
+	long start = (long)grid.getStartRow() * size + grid.getStartCol();
+	long goal = (long)grid.getGoalRow() * size + grid.getGoalCol();
+
+	ReachedSquares fromStart, toGoal;
+	SearchNode endNode = { -1, 0, 0, false };
+	fromStart.set(start, endNode);
+	toGoal.set(goal, endNode);
+
+	std::vector<long> forward(1, start);
+	std::vector<long> backward(1, goal);
+	std::vector<long> next;
+
+	// Square where the sides met with the fewest moves in all. Every meeting
+	// in the move being searched is checked before stopping, as the first
+	// one found may not be the shortest.
+	long meeting = start == goal ? start : -1;
+	int fewestMoves = INT_MAX;
+
+	while (meeting == -1 && !forward.empty() && !backward.empty()) {
+		next.clear();
+		if (forward.size() <= backward.size()) {
+			for (int i = 0; i < forward.size(); i++) {
+				long square = forward[i];
+				int moves = fromStart.find(square)->moves + 1;
+				solution.statesExpanded++;
+
+				for (int direction = 0; direction < DIRECTION_COUNT; direction++) {
+					int stopRow = square / size;
+					int stopCol = square % size;
+					grid.slide(direction, stopRow, stopCol);
+					long stop = (long)stopRow * size + stopCol;
+					if (fromStart.find(stop) != NULL) {
+						continue;
+					}
+
+					SearchNode stopNode = { square, moves, direction, false };
+					fromStart.set(stop, stopNode);
+					next.push_back(stop);
+
+					SearchNode *other = toGoal.find(stop);
+					if (other != NULL && moves + other->moves < fewestMoves) {
+						fewestMoves = moves + other->moves;
+						meeting = stop;
+					}
+				}
+			}
+			forward.swap(next);
+		} else {
+			for (int i = 0; i < backward.size(); i++) {
+				long square = backward[i];
+				int row = square / size;
+				int col = square % size;
+				int moves = toGoal.find(square)->moves + 1;
+				solution.statesExpanded++;
+
+				for (int direction = 0; direction < DIRECTION_COUNT; direction++) {
+					int rowStep = directionRowSteps[direction];
+					int colStep = directionColSteps[direction];
+
+					// As in SOLVER_BFS, every free square behind a stop slides to it
+					if (isFree(grid, row + rowStep, col + colStep)) {
+						continue;
+					}
+					for (int fromRow = row - rowStep, fromCol = col - colStep; isFree(grid, fromRow, fromCol); 
+						fromRow -= rowStep, fromCol -= colStep) {
+
+						long from = (long)fromRow * size + fromCol;
+						if (toGoal.find(from) != NULL) {
+							continue;
+						}
+
+						SearchNode fromNode = { square, moves, direction, false };
+						toGoal.set(from, fromNode);
+						next.push_back(from);
+
+						SearchNode *other = fromStart.find(from);
+						if (other != NULL && moves + other->moves < fewestMoves) {
+							fewestMoves = moves + other->moves;
+							meeting = from;
+						}
+					}
+				}
+			}
+			backward.swap(next);
+		}
+	}
+
+	if (meeting == -1) {
+		return false;
+	}
+
+	addMovesFromStart(fromStart, meeting, solution);
+	for (SearchNode *node = toGoal.find(meeting); node->next != -1; node = toGoal.find(node->next)) {
+		solution.moves.push_back(node->direction);
+	}
+	return true;
+}
+
+/**
+ * Set how many threads SOLVER_PARALLEL_BFS uses
+ * @param threads Number of threads, or 0 for one per core
+ */
+void setSolverThreads(int threads) {
+	solverThreads = threads;
+}
+
+/**
+ * Find the fewest moves from the start to the goal
+ * @param grid Maze to solve, with its columns built
+ * @param solver SOLVER_ number of the search to use
+ * @param solution Set to the moves found, if any, and how much was searched
+ * @return true if the goal can be reached
+ */
+bool solveMaze(const MazeGrid &grid, int solver, Solution &solution) {
+	solution.moves.clear();
+	solution.statesExpanded = 0;
+
+	switch (solver) {
+		case SOLVER_BFS:
+			solution.solved = solveBfs(grid, solution);
+			break;
+		case SOLVER_PARALLEL_BFS:
+			solution.solved = solveParallelBfs(grid, solution);
+			break;
+		case SOLVER_ASTAR:
+			solution.solved = solveAStar(grid, solution);
+			break;
+		case SOLVER_BIDIRECTIONAL:
+			solution.solved = solveBidirectional(grid, solution);
+			break;
+		default:
+			solution.solved = false;
+			break;
+	}
+	return solution.solved;
+}
+
+/**
+ * @return Name of a solver, as given on the command line
+ */
+const char *getSolverName(int solver) {
+	if (solver < 0 || solver >= SOLVER_COUNT) {
+		return "unknown";
+	}
+	return solverNames[solver];
+}
+
+/**
+ * @return SOLVER_ number of a solver name, or -1 if there is none
+ */
+int findSolver(const char *name) {
+	for (int solver = 0; solver < SOLVER_COUNT; solver++) {
+		if (strcmp(name, solverNames[solver]) == 0) {
+			return solver;
+		}
+	}
+	return -1;
+}
+
+/**
+ * Play moves from the start, as the game would
+ * @return true if the ball ends on the goal
+ */
+bool checkSolution(const MazeGrid &grid, const std::vector<int> &moves) {
+	int row = grid.getStartRow();
+	int col = grid.getStartCol();
+	for (int i = 0; i < moves.size(); i++) {
+		grid.slide(moves[i], row, col);
+	}
+	return row == grid.getGoalRow() && col == grid.getGoalCol();
+}
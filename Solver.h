@@ -0,0 +1,71 @@
+/**
+ * Find the fewest moves that take the ball from its start to the goal.
+ * A move slides the ball until the next square is a block or the edge of the
+ * maze, as in the game, so the ball only reaches the goal by stopping on it.
+ * Needs no OpenGL, so mazes can be solved without a window.
+ *
+ * Each way of searching is chosen by a SOLVER_ number:
+ *  - SOLVER_BFS searches backwards from the goal, one move at a time, until it
+ *    reaches the start. Every square it reaches keeps a visited bit and the
+ *    direction of the first move on a shortest path from it, and the squares
+ *    found in the last move and the next are bitmaps too, 5 bits in all.
+ *    A 10000x10000 maze needs about 63 MB on top of the maze, however many
+ *    squares each move finds. The moves are read off by sliding from the
+ *    start.
+ *  - SOLVER_PARALLEL_BFS is the same search shared between threads, one
+ *    move at a time. Threads claim squares in an atomic visited bitmap and
+ *    add them to an atomic bitmap of the next frontier, so it takes the same
+ *    5 bits per square and nothing is gathered on one thread between moves.
+ *    While few squares are being searched from, it works backwards from them
+ *    (top down); once that would step over many more squares than are left
+ *    unvisited, it checks every unvisited square for a move into them
+ *    instead (bottom up).
+ *    The moves can differ from SOLVER_BFS, but not how many there are.
+ *  - SOLVER_ASTAR searches forwards from the start, expanding first the
+ *    squares with the fewest moves from the start plus a lower bound on the
+ *    moves left: 0 on the goal, 1 in its row or column, 2 anywhere else.
+ *  - SOLVER_BIDIRECTIONAL searches forwards from the start and backwards
+ *    from the goal, one move at a time from the smaller side, until they
+ *    meet.
+ * SOLVER_ASTAR and SOLVER_BIDIRECTIONAL only store the squares they reach,
+ * in hash tables, so they suit single questions on big mazes where the goal
+ * is found long before the whole maze is searched. Each square costs more
+ * than in SOLVER_BFS.
+ */
+
+#ifndef SOLVER_H
+#define SOLVER_H
+
+#include <vector>
+
+#include "MazeGrid.h"
+#include "SquareBitmap.h"
+
+#define SOLVER_BFS 0
+#define SOLVER_PARALLEL_BFS 1
+#define SOLVER_ASTAR 2
+#define SOLVER_BIDIRECTIONAL 3
+#define SOLVER_COUNT 4
+
+// Bottom up once searching top down would step over more than ALPHA squares
+// per unvisited square, back to top down below 1/BETA of all free squares
+#define SOLVER_BOTTOM_UP_ALPHA 16
+#define SOLVER_BOTTOM_UP_BETA 24
+// Summary words of the frontier, 4096 squares each, a thread takes at a time searching top down
+#define SOLVER_TOP_DOWN_CHUNK 16
+
+struct Solution {
+	bool solved;			// false if the goal can't be reached from the start
+	std::vector<int> moves;	// NORTH, EAST, SOUTH or WEST, from the start
+	long statesExpanded;	// squares whose moves were followed
+};
+
+bool solveMaze(const MazeGrid &grid, int solver, Solution &solution);
+void setSolverThreads(int threads);
+const char *getSolverName(int solver);
+int findSolver(const char *name);
+bool checkSolution(const MazeGrid &grid, const std::vector<int> &moves);
+long searchBackwards(const MazeGrid &grid, SquareBitmap &frontier, std::vector<uint64_t> &visited, 
+	SquareBitmap &next, uint64_t *firstMoves);
+
+#endif
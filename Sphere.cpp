@@ -22,14 +22,12 @@ Sphere::Sphere(float radius, int vertDiv, int horzDiv): valsPerVert(VALS_PER_VER
 	int v, h;
 
 	vertices = new float[vertDiv*horzDiv*3];
-	normals = new float[vertDiv*horzDiv*3];
 	indices = new unsigned int[vertDiv*horzDiv*6];
 
 	vertCount = 0;
-	normCount = 0;
 	indCount = 0;
 
-	// Construct vertex, normal and tex-coords
+	// Construct vertices
 	for (v=0; v<vertDiv; v++) {
 		for (h=0; h<horzDiv; h++) {
 			float x = cos(2*M_PI * h * H) * sin(M_PI * v * V);
@@ -39,10 +37,6 @@ Sphere::Sphere(float radius, int vertDiv, int horzDiv): valsPerVert(VALS_PER_VER
 			vertices[vertCount++] = x*radius;
 			vertices[vertCount++] = y*radius;
 			vertices[vertCount++] = z*radius;
-
-			normals[normCount++] = 0.5*(x+1.0);
-			normals[normCount++] = 0.5*(y+1.0);
-			normals[normCount++] = 0.5*(z+1.0);
 		}
 	}
 	
@@ -82,6 +76,5 @@ Sphere::Sphere(float radius, int vertDiv, int horzDiv): valsPerVert(VALS_PER_VER
 
 Sphere::~Sphere() {
 	delete []indices;
-	delete []normals;
 	delete []vertices;
 }
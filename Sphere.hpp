@@ -6,7 +6,7 @@ public:
 
 	/**
 	 * Generates a new sphere mesh with given radius, vertical sub-divisions and horizontal
-	 * sub-divisions. Produces vertex positions, normal vectors, and element
+	 * sub-divisions. Produces vertex positions and element
 	 * indices available for use in vertex arrays.
 	 * More sub-divisions generates a smoother sphere.
 	 * It is a good idea to have vertical and horizontal divisions equal.
@@ -18,12 +18,10 @@ public:
 	~Sphere();
 
 	float *vertices;		// Vertex position (x,y,z)
-	float *normals;			// Normal vector (x,y,z)
 	unsigned int *indices;	// Element indices
 
 	// Counts of array elements
 	int vertCount;
-	int normCount;
 	int indCount;
 
 	int valsPerVert;
@@ -0,0 +1,59 @@
+/**
+ * Lock-free queue for passing items from exactly one producer thread
+ * to exactly one consumer thread.
+ * Fixed capacity: push fails instead of blocking when the queue is full.
+ */
+
+#ifndef SPSCQUEUE_H
+#define SPSCQUEUE_H
+
+#include <atomic>
+
+template <typename T, unsigned int Capacity>
+class SpscQueue {
+private:
+	T items[Capacity];
+
+	// Next slot to pop, only written by the consumer
+	std::atomic<unsigned int> head;
+	// Next slot to push, only written by the producer
+	std::atomic<unsigned int> tail;
+
+public:
+	SpscQueue(): head(0), tail(0) {}
+
+	/**
+	 * Add an item. Only call from the producer thread.
+	 * @return false if the queue is full and the item was dropped
+	 */
+	bool push(const T &item) {
+		unsigned int currentTail = tail.load(std::memory_order_relaxed);
+		unsigned int nextTail = (currentTail + 1) % Capacity;
+
+		if (nextTail == head.load(std::memory_order_acquire)) {
+			return false;
+		}
+
+		items[currentTail] = item;
+		tail.store(nextTail, std::memory_order_release);
+		return true;
+	}
+
+	/**
+	 * Remove the oldest item. Only call from the consumer thread.
+	 * @return false if the queue is empty
+	 */
+	bool pop(T &item) {
+		unsigned int currentHead = head.load(std::memory_order_relaxed);
+
+		if (currentHead == tail.load(std::memory_order_acquire)) {
+			return false;
+		}
+
+		item = items[currentHead];
+		head.store((currentHead + 1) % Capacity, std::memory_order_release);
+		return true;
+	}
+};
+
+#endif
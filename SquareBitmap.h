@@ -0,0 +1,91 @@
+/**
+ * Set of squares of a maze, one bit each, with a summary bit for each word
+ * of the bitmap that has any set, so squares are found without scanning
+ * the empty parts of the maze. Searches keep the squares found in one move
+ * in these, so memory doesn't grow with how many there are.
+ */
+
+#ifndef SQUAREBITMAP_H
+#define SQUAREBITMAP_H
+
+#include <stdint.h>
+#include <vector>
+
+class SquareBitmap {
+private:
+	std::vector<uint64_t> words;
+	std::vector<uint64_t> summary;
+	long summaryWord;	// where takeNext() goes on looking
+	long count;
+
+public:
+	SquareBitmap(long squares):
+		words((squares + 63) / 64, 0),
+		summary(((squares + 63) / 64 + 63) / 64, 0),
+		summaryWord(0),
+		count(0) {
+	}
+
+	bool empty() const {
+		return count == 0;
+	}
+
+	void add(long square) {
+		words[square >> 6] |= 1ull << (square & 63);
+		summary[square >> 12] |= 1ull << ((square >> 6) & 63);
+		count++;
+	}
+
+	/**
+	 * Add the squares of one word of the bitmap that aren't in the set yet
+	 * @param word Index of the word, squares word*64 to word*64 + 63
+	 * @param bits Squares to add
+	 */
+	void addWord(long word, uint64_t bits) {
+		if (bits == 0) {
+			return;
+		}
+		words[word] |= bits;
+		summary[word >> 6] |= 1ull << (word & 63);
+		count += __builtin_popcountll(bits);
+	}
+
+	/**
+	 * Call visit(square) for each square in the set, lowest first, leaving it in the set
+	 */
+	template <typename Visit>
+	void forEach(Visit visit) const {
+		for (long summaryWord = 0; summaryWord < summary.size(); summaryWord++) {
+			for (uint64_t setWords = summary[summaryWord]; setWords != 0; setWords &= setWords - 1) {
+				long word = summaryWord*64 + __builtin_ctzll(setWords);
+				for (uint64_t bits = words[word]; bits != 0; bits &= bits - 1) {
+					visit(word*64 + __builtin_ctzll(bits));
+				}
+			}
+		}
+	}
+
+	/**
+	 * Remove a square from the set, lowest first
+	 * @return The square, or -1 once the set is empty
+	 */
+	long takeNext() {
+		for (; summaryWord < summary.size(); summaryWord++) {
+			if (summary[summaryWord] == 0) {
+				continue;
+			}
+			long word = summaryWord*64 + __builtin_ctzll(summary[summaryWord]);
+			long square = word*64 + __builtin_ctzll(words[word]);
+			words[word] &= words[word] - 1;
+			if (words[word] == 0) {
+				summary[summaryWord] &= summary[summaryWord] - 1;
+			}
+			count--;
+			return square;
+		}
+		summaryWord = 0;
+		return -1;
+	}
+};
+
+#endif
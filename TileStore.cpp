@@ -0,0 +1,603 @@
+#include "Direction.h"
+#include "MazeBinary.h"
+#include "MazeLoader.h"
+#include "TileStore.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static_assert(sizeof(MazeTiledHeader) == 64, "tiled maze header must have no padding");
+static_assert(TILE_SIZE == 64, "each row of a tile must be one 64 bit word");
+
+// Words per tile in the file: the rows, then the checksum
+#define TILE_RECORD_WORDS (TILE_SIZE + 1)
+
+/**
+ * Checksum the header, up to the checksum itself
+ */
+uint64_t tiledHeaderChecksum(const MazeTiledHeader &header) {
+	uint64_t words[offsetof(MazeTiledHeader, checksum) / 8];
+	memcpy(words, &header, sizeof(words));
+
+	uint64_t checksum = MAZE_TILED_VERSION;
+	for (size_t i = 0; i < sizeof(words) / 8; i++) {
+		checksum = checksumWord(checksum, words[i]);
+	}
+	return checksum;
+}
+
+/**
+ * Checksum the rows of a tile
+ * The tile's index is included, so a tile written in the wrong place is rejected.
+ */
+uint64_t tileChecksum(long index, const uint64_t *rows) {
+	uint64_t checksum = checksumWord(MAZE_TILED_VERSION, index);
+	for (int i = 0; i < TILE_SIZE; i++) {
+		checksum = checksumWord(checksum, rows[i]);
+	}
+	return checksum;
+}
+
+/**
+ * @return true if the data starts with the tiled maze magic number
+ */
+bool isMazeTiled(const void *data, size_t length) {
+	return length >= MAZE_TILED_MAGIC_SIZE && memcmp(data, MAZE_TILED_MAGIC, MAZE_TILED_MAGIC_SIZE) == 0;
+}
+
+/**
+ * @return true if the file starts with the tiled maze magic number
+ */
+bool isMazeTiledFile(const char *path) {
+	char magic[MAZE_TILED_MAGIC_SIZE];
+	FILE *file = fopen(path, "rb");
+	if (file == NULL) {
+		return false;
+	}
+	size_t read = fread(magic, 1, sizeof(magic), file);
+	fclose(file);
+	return isMazeTiled(magic, read);
+}
+
+TileStore::TileStore():
+	fd(-1),
+	mazeSize(0),
+	tilesPerSide(0),
+	goalRow(0),
+	goalCol(0),
+	startRow(0),
+	startCol(0),
+	hits(0),
+	misses(0),
+	prefetched(0),
+	evicted(0),
+	damageReported(false),
+	stopping(false) {
+}
+
+TileStore::~TileStore() {
+	if (ioThread.joinable()) {
+		{
+			std::lock_guard<std::mutex> lock(cacheMutex);
+			stopping = true;
+		}
+		requested.notify_one();
+		ioThread.join();
+	}
+
+	if (fd != -1) {
+		::close(fd);
+	}
+}
+
+/**
+ * Open a tiled maze and start the I/O thread
+ * Only the header is read, and the tiles holding the goal and start.
+ * @param path Maze file
+ * @param error Set to a message if the file can't be used
+ * @return true if the maze can be read
+ */
+bool TileStore::open(const char *path, std::string &error) {
+	char message[128];
+
+	this->path = path;
+	fd = ::open(path, O_RDONLY);
+	if (fd == -1) {
+		setMazeError(error, path, 0, 0, strerror(errno));
+		return false;
+	}
+
+	MazeTiledHeader header;
+	if (pread(fd, &header, sizeof(header), 0) != sizeof(header)) {
+		setMazeError(error, path, 0, 0, "tiled maze header is truncated");
+		return false;
+	}
+	if (!isMazeTiled(&header, sizeof(header))) {
+		setMazeError(error, path, 0, 0, "not a tiled maze");
+		return false;
+	}
+	if (header.version != MAZE_TILED_VERSION) {
+		snprintf(message, sizeof(message), "tiled maze version %u isn't supported, expected %d",
+			header.version, MAZE_TILED_VERSION);
+		setMazeError(error, path, 0, 0, message);
+		return false;
+	}
+	if (tiledHeaderChecksum(header) != header.checksum) {
+		setMazeError(error, path, 0, 0, "header checksum doesn't match, the file is damaged");
+		return false;
+	}
+	if (header.headerSize != sizeof(header) || header.reserved[0] != 0 || header.reserved[1] != 0) {
+		setMazeError(error, path, 0, 0, "tiled maze header is invalid");
+		return false;
+	}
+	if (header.tileSize != TILE_SIZE) {
+		snprintf(message, sizeof(message), "tiles are %u squares, expected %d", header.tileSize, TILE_SIZE);
+		setMazeError(error, path, 0, 0, message);
+		return false;
+	}
+	if (header.size < 2 || header.size > MAZE_TILED_MAX_SIZE) {
+		snprintf(message, sizeof(message), "maze size must be from 2 to %d", MAZE_TILED_MAX_SIZE);
+		setMazeError(error, path, 0, 0, message);
+		return false;
+	}
+	if (header.tilesPerSide != (header.size + TILE_SIZE - 1) / TILE_SIZE) {
+		setMazeError(error, path, 0, 0, "number of tiles doesn't match the maze size");
+		return false;
+	}
+	if (header.goalRow >= header.size || header.goalCol >= header.size ||
+		header.startRow >= header.size || header.startCol >= header.size) {
+		setMazeError(error, path, 0, 0, "goal or start is outside the maze");
+		return false;
+	}
+
+	struct stat info;
+	long tileCount = (long)header.tilesPerSide * header.tilesPerSide;
+	long expected = sizeof(header) + tileCount * TILE_RECORD_WORDS * 8;
+	if (fstat(fd, &info) != 0 || info.st_size != expected) {
+		snprintf(message, sizeof(message), "tiled maze is %ld bytes, expected %ld", (long)info.st_size, expected);
+		setMazeError(error, path, 0, 0, message);
+		return false;
+	}
+
+	mazeSize = header.size;
+	tilesPerSide = header.tilesPerSide;
+	goalRow = header.goalRow;
+	goalCol = header.goalCol;
+	startRow = header.startRow;
+	startCol = header.startCol;
+
+	// The rest of the maze is only checked as it is read
+	if (isBlock(goalRow, goalCol)) {
+		setMazeError(error, path, 0, 0, "goal is a block");
+		return false;
+	}
+	if (isBlock(startRow, startCol)) {
+		setMazeError(error, path, 0, 0, "start is a block");
+		return false;
+	}
+
+	ioThread = std::thread(&TileStore::ioLoop, this);
+	return true;
+}
+
+/**
+ * Read and decode one tile from the file
+ * A tile that can't be read or is damaged is reported once and filled with
+ * blocks, so the ball can't enter it.
+ * @param index tileRow*tilesPerSide + tileCol
+ */
+std::shared_ptr<MazeTile> TileStore::readTile(long index) {
+	uint64_t record[TILE_RECORD_WORDS];
+	off_t offset = sizeof(MazeTiledHeader) + (off_t)index * sizeof(record);
+
+	std::shared_ptr<MazeTile> tile = std::make_shared<MazeTile>();
+	if (pread(fd, record, sizeof(record), offset) == sizeof(record) &&
+		tileChecksum(index, record) == record[TILE_SIZE]) {
+		memcpy(tile->rows, record, sizeof(tile->rows));
+	} else {
+		std::lock_guard<std::mutex> lock(cacheMutex);
+		if (!damageReported) {
+			std::cerr << path << ": tile " << index / tilesPerSide << "," << index % tilesPerSide
+				<< " is damaged, treating it as blocks" << std::endl;
+			damageReported = true;
+		}
+		memset(tile->rows, 0xff, sizeof(tile->rows));
+	}
+
+	memcpy(tile->columns, tile->rows, sizeof(tile->columns));
+	transposeBlock(tile->columns);
+
+	return tile;
+}
+
+/**
+ * Add a tile to the cache, evicting the least recently used tiles to make room
+ * Call with cacheMutex locked.
+ */
+void TileStore::insert(long index, std::shared_ptr<const MazeTile> tile) {
+	// Another thread may have read the same tile meanwhile
+	if (cache.count(index) != 0) {
+		return;
+	}
+
+	while (cache.size() >= TILE_CACHE_SIZE) {
+		cache.erase(recentlyUsed.back());
+		recentlyUsed.pop_back();
+		evicted++;
+	}
+
+	recentlyUsed.push_front(index);
+	CacheEntry entry = { tile, recentlyUsed.begin() };
+	cache[index] = entry;
+}
+
+/**
+ * I/O thread: read the requested tiles ahead of time until the store is destroyed
+ */
+void TileStore::ioLoop() {
+	std::unique_lock<std::mutex> lock(cacheMutex);
+	while (true) {
+		requested.wait(lock, [this] { return stopping || !requests.empty(); });
+		if (stopping) {
+			return;
+		}
+
+		long index = requests.front();
+		requests.pop_front();
+		if (cache.count(index) != 0) {
+			continue;
+		}
+
+		// Let other threads use the cache while reading
+		lock.unlock();
+		std::shared_ptr<const MazeTile> tile = readTile(index);
+		lock.lock();
+
+		insert(index, tile);
+		prefetched++;
+	}
+}
+
+/**
+ * Get a tile, reading it from the file if it isn't in memory
+ * The tile stays valid while it is held, even if it is evicted.
+ * @param tileRow Row of tiles, from 0 to getTilesPerSide()-1
+ * @param tileCol Column of tiles, from 0 to getTilesPerSide()-1
+ */
+std::shared_ptr<const MazeTile> TileStore::getTile(int tileRow, int tileCol) {
+	long index = (long)tileRow * tilesPerSide + tileCol;
+
+	{
+		std::lock_guard<std::mutex> lock(cacheMutex);
+		std::unordered_map<long, CacheEntry>::iterator found = cache.find(index);
+		if (found != cache.end()) {
+			recentlyUsed.splice(recentlyUsed.begin(), recentlyUsed, found->second.used);
+			hits++;
+			return found->second.tile;
+		}
+		misses++;
+	}
+
+	std::shared_ptr<const MazeTile> tile = readTile(index);
+
+	std::lock_guard<std::mutex> lock(cacheMutex);
+	insert(index, tile);
+	return tile;
+}
+
+/**
+ * Ask the I/O thread to read a tile, if it isn't in memory or asked for already
+ * Tiles outside the maze are ignored.
+ */
+void TileStore::prefetch(int tileRow, int tileCol) {
+	if (tileRow < 0 || tileCol < 0 || tileRow >= tilesPerSide || tileCol >= tilesPerSide) {
+		return;
+	}
+	long index = (long)tileRow * tilesPerSide + tileCol;
+
+	{
+		std::lock_guard<std::mutex> lock(cacheMutex);
+		if (cache.count(index) != 0 || std::find(requests.begin(), requests.end(), index) != requests.end()) {
+			return;
+		}
+		if (requests.size() == TILE_PREFETCH_QUEUE_SIZE) {
+			requests.pop_front();
+		}
+		requests.push_back(index);
+	}
+	requested.notify_one();
+}
+
+/**
+ * @return true if the square is a block, reading its tile if needed
+ */
+bool TileStore::isBlock(int row, int col) {
+	std::shared_ptr<const MazeTile> tile = getTile(row / TILE_SIZE, col / TILE_SIZE);
+	return (tile->rows[row % TILE_SIZE] >> (col % TILE_SIZE)) & 1;
+}
+
+/**
+ * Find the first block at or after a square, reading tiles as needed
+ * @param alongRow true to search along a row, false along a column
+ * @param line Row or column to search
+ * @param from First square to look at
+ * @return Index of the block, or the number of squares covered by tiles if there is none
+ */
+int TileStore::nextBlock(bool alongRow, int line, int from) {
+	int lineTile = line / TILE_SIZE;
+	int bit = line % TILE_SIZE;
+
+	for (int tileIndex = from / TILE_SIZE; tileIndex < tilesPerSide; tileIndex++) {
+		std::shared_ptr<const MazeTile> tile = alongRow ? getTile(lineTile, tileIndex) : getTile(tileIndex, lineTile);
+		uint64_t blocks = alongRow ? tile->rows[bit] : tile->columns[bit];
+		if (tileIndex == from / TILE_SIZE) {
+			blocks &= ~0ull << (from % TILE_SIZE);
+		}
+		if (blocks != 0) {
+			return tileIndex*TILE_SIZE + __builtin_ctzll(blocks);
+		}
+	}
+	return tilesPerSide*TILE_SIZE;
+}
+
+/**
+ * Find the last block at or before a square, reading tiles as needed
+ * @param alongRow true to search along a row, false along a column
+ * @param line Row or column to search
+ * @param from First square to look at
+ * @return Index of the block, or -1 if there is none
+ */
+int TileStore::previousBlock(bool alongRow, int line, int from) {
+	if (from < 0) {
+		return -1;
+	}
+
+	int lineTile = line / TILE_SIZE;
+	int bit = line % TILE_SIZE;
+
+	for (int tileIndex = from / TILE_SIZE; tileIndex >= 0; tileIndex--) {
+		std::shared_ptr<const MazeTile> tile = alongRow ? getTile(lineTile, tileIndex) : getTile(tileIndex, lineTile);
+		uint64_t blocks = alongRow ? tile->rows[bit] : tile->columns[bit];
+		if (tileIndex == from / TILE_SIZE) {
+			blocks &= ~0ull >> (63 - from % TILE_SIZE);
+		}
+		if (blocks != 0) {
+			return tileIndex*TILE_SIZE + 63 - __builtin_clzll(blocks);
+		}
+	}
+	return -1;
+}
+
+/**
+ * Slide from a square until the next square is a block or the edge of the maze
+ * Tiles along the way are read if they aren't in memory, so this can block on disk.
+ * @param direction NORTH, EAST, SOUTH or WEST
+ * @param row Row to start from, set to the row the slide stops in
+ * @param col Column to start from, set to the column the slide stops in
+ */
+void TileStore::slide(int direction, int &row, int &col) {
+	// Squares past the edge are blocks, so the edge needs no check of its own
+	switch (direction) {
+		case NORTH:
+			row = previousBlock(false, col, row - 1) + 1;
+			break;
+
+		case SOUTH:
+			row = nextBlock(false, col, row + 1) - 1;
+			break;
+
+		case EAST:
+			col = nextBlock(true, row, col + 1) - 1;
+			break;
+
+		case WEST:
+			col = previousBlock(true, row, col - 1) + 1;
+			break;
+
+		default:
+			break;
+	}
+}
+
+/**
+ * Copy a square part of the maze into a grid, reading tiles as needed
+ * The grid's goal and start are left in its top left square. Squares past the
+ * edge of the maze are copied as free, so the grid holds only the maze's own
+ * walls for drawing. Slides read the tiles, which keep the edge as blocks.
+ * @param firstRow Top row to copy, a multiple of TILE_SIZE
+ * @param firstCol Left column to copy, a multiple of TILE_SIZE
+ * @param size Rows and columns to copy, a multiple of TILE_SIZE that fits in the maze's tiles
+ * @param window Grid to copy into
+ */
+void TileStore::copyWindow(int firstRow, int firstCol, int size, MazeGrid &window) {
+	uint64_t *words = window.allocate(size);
+	int wordsPerRow = window.getWordsPerRow();
+
+	for (int tileRow = 0; tileRow < size / TILE_SIZE; tileRow++) {
+		for (int tileCol = 0; tileCol < size / TILE_SIZE; tileCol++) {
+			std::shared_ptr<const MazeTile> tile = getTile(firstRow / TILE_SIZE + tileRow, firstCol / TILE_SIZE + tileCol);
+			int colsInMaze = mazeSize - (firstCol + tileCol*TILE_SIZE);
+			uint64_t inMaze = (colsInMaze >= TILE_SIZE) ? ~0ull : ~(~0ull << colsInMaze);
+			for (int i = 0; i < TILE_SIZE; i++) {
+				bool rowInMaze = firstRow + tileRow*TILE_SIZE + i < mazeSize;
+				words[(long)(tileRow*TILE_SIZE + i) * wordsPerRow + tileCol] = rowInMaze ? (tile->rows[i] & inMaze) : 0;
+			}
+		}
+	}
+}
+
+int TileStore::getGoalRow() const {
+	return goalRow;
+}
+
+int TileStore::getGoalCol() const {
+	return goalCol;
+}
+
+int TileStore::getStartRow() const {
+	return startRow;
+}
+
+int TileStore::getStartCol() const {
+	return startCol;
+}
+
+/**
+ * @return Number of times a tile was already in memory
+ */
+long TileStore::getHits() {
+	std::lock_guard<std::mutex> lock(cacheMutex);
+	return hits;
+}
+
+/**
+ * @return Number of times a tile had to be read straight away
+ */
+long TileStore::getMisses() {
+	std::lock_guard<std::mutex> lock(cacheMutex);
+	return misses;
+}
+
+/**
+ * @return Number of tiles read ahead by the I/O thread
+ */
+long TileStore::getPrefetched() {
+	std::lock_guard<std::mutex> lock(cacheMutex);
+	return prefetched;
+}
+
+/**
+ * @return Number of tiles dropped from memory to make room for others
+ */
+long TileStore::getEvicted() {
+	std::lock_guard<std::mutex> lock(cacheMutex);
+	return evicted;
+}
+
+TileWriter::TileWriter():
+	file(NULL),
+	mazeSize(0),
+	tilesPerSide(0),
+	bandsWritten(0),
+	failed(false) {
+}
+
+TileWriter::~TileWriter() {
+	if (file != NULL) {
+		fclose(file);
+	}
+}
+
+/**
+ * Create a tiled maze file and write its header
+ * @param path File to write
+ * @param size Rows and columns of the maze
+ * @param error Set to a message if the file can't be created
+ * @return true if bands can be written
+ */
+bool TileWriter::open(const char *path, int size, int goalRow, int goalCol, int startRow, int startCol,
+	std::string &error) {
+
+	this->path = path;
+	mazeSize = size;
+	tilesPerSide = (size + TILE_SIZE - 1) / TILE_SIZE;
+	record.resize(TILE_RECORD_WORDS);
+
+	MazeTiledHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, MAZE_TILED_MAGIC, MAZE_TILED_MAGIC_SIZE);
+	header.version = MAZE_TILED_VERSION;
+	header.headerSize = sizeof(header);
+	header.size = size;
+	header.tileSize = TILE_SIZE;
+	header.tilesPerSide = tilesPerSide;
+	header.goalRow = goalRow;
+	header.goalCol = goalCol;
+	header.startRow = startRow;
+	header.startCol = startCol;
+	header.checksum = tiledHeaderChecksum(header);
+
+	file = fopen(path, "wb");
+	if (file == NULL) {
+		setMazeError(error, path, 0, 0, strerror(errno));
+		return false;
+	}
+	failed = fwrite(&header, sizeof(header), 1, file) != 1;
+	return true;
+}
+
+/**
+ * Write the next TILE_SIZE rows of the maze
+ * Squares past the edge of the maze are written as blocks.
+ * @param rows TILE_SIZE rows of getTilesPerSide() words each, in the layout
+ *	of MazeGrid, so tile c of the band is word c of each row. Rows past the
+ *	bottom of the maze are ignored.
+ */
+void TileWriter::writeBand(const uint64_t *rows) {
+	long firstRow = (long)bandsWritten * TILE_SIZE;
+
+	for (int tileCol = 0; tileCol < tilesPerSide && !failed; tileCol++) {
+		int firstCol = tileCol * TILE_SIZE;
+		uint64_t padding = (mazeSize - firstCol >= TILE_SIZE) ? 0 : ~0ull << (mazeSize - firstCol);
+
+		for (int i = 0; i < TILE_SIZE; i++) {
+			record[i] = (firstRow + i < mazeSize) ? (rows[(long)i * tilesPerSide + tileCol] | padding) : ~0ull;
+		}
+		record[TILE_SIZE] = tileChecksum((long)bandsWritten * tilesPerSide + tileCol, record.data());
+
+		failed = fwrite(record.data(), sizeof(uint64_t), record.size(), file) != record.size();
+	}
+	bandsWritten++;
+}
+
+/**
+ * Finish the file
+ * @param error Set to a message if anything couldn't be written
+ * @return true if the whole maze was written
+ */
+bool TileWriter::close(std::string &error) {
+	bool ok = fclose(file) == 0 && !failed;
+	file = NULL;
+
+	if (!ok) {
+		setMazeError(error, path.c_str(), 0, 0, "couldn't write the whole file");
+		return false;
+	}
+	if (bandsWritten != tilesPerSide) {
+		setMazeError(error, path.c_str(), 0, 0, "not every row of the maze was written");
+		return false;
+	}
+	return true;
+}
+
+/**
+ * Write a grid in the tiled format
+ * @param path File to write
+ * @param grid Grid to write
+ * @param error Set to a message if writing fails
+ * @return true if the file was written
+ */
+bool writeMazeTiled(const char *path, const MazeGrid &grid, std::string &error) {
+	TileWriter writer;
+	if (!writer.open(path, grid.size(), grid.getGoalRow(), grid.getGoalCol(),
+		grid.getStartRow(), grid.getStartCol(), error)) {
+		return false;
+	}
+
+	// The grid has one word per tile in each row, so bands are copied as they are
+	int wordsPerRow = grid.getWordsPerRow();
+	std::vector<uint64_t> band((long)TILE_SIZE * wordsPerRow, 0);
+	for (int firstRow = 0; firstRow < grid.size(); firstRow += TILE_SIZE) {
+		int rows = std::min(TILE_SIZE, grid.size() - firstRow);
+		std::copy(grid.getRow(firstRow), grid.getRow(firstRow) + (long)rows * wordsPerRow, band.begin());
+		writer.writeBand(band.data());
+	}
+
+	return writer.close(error);
+}
@@ -0,0 +1,163 @@
+/**
+ * Tiled maze format, for mazes too big to hold in memory.
+ * The maze is split into TILE_SIZE x TILE_SIZE tiles, stored one after
+ * another by row of tiles. Each tile is TILE_SIZE words, one per row of the
+ * tile with column c in bit c, followed by a checksum word. A set bit is a
+ * block. Squares past the edge of the maze are stored as blocks, so the ball
+ * stops at the edge without a special case.
+ *
+ * A TileStore reads tiles from the file as they are needed and keeps the most
+ * recently used ones in memory, up to TILE_CACHE_SIZE of them. Tiles expected
+ * to be needed soon can be read ahead of time by a background I/O thread.
+ * Asking for a tile that isn't in memory reads it straight away.
+ * The store can be used from any thread.
+ *
+ * All values are little endian.
+ */
+
+#ifndef TILESTORE_H
+#define TILESTORE_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdio>
+#include <deque>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <stdint.h>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "MazeGrid.h"
+
+#define MAZE_TILED_MAGIC "MAZETIL\x1a"
+#define MAZE_TILED_MAGIC_SIZE 8
+#define MAZE_TILED_VERSION 1
+
+// Squares along each side of a tile, each row of a tile is one 64 bit word
+#define TILE_SIZE 64
+// Largest maze size accepted, keeps every square index within an int
+#define MAZE_TILED_MAX_SIZE (1 << 30)
+
+// Tiles kept in memory, about 1 KB each
+#define TILE_CACHE_SIZE 4096
+// Tiles waiting to be read ahead, older requests are dropped first
+#define TILE_PREFETCH_QUEUE_SIZE 256
+
+struct MazeTiledHeader {
+	char magic[MAZE_TILED_MAGIC_SIZE];
+	uint32_t version;
+	uint32_t headerSize;	// bytes before the first tile
+	uint32_t size;			// rows and columns
+	uint32_t tileSize;		// TILE_SIZE
+	uint32_t tilesPerSide;
+	uint32_t goalRow, goalCol;
+	uint32_t startRow, startCol;
+	uint32_t reserved[2];	// 0
+	uint64_t checksum;		// of the header up to here
+};
+
+// One tile, decoded
+struct MazeTile {
+	uint64_t rows[TILE_SIZE];
+	uint64_t columns[TILE_SIZE];	// transposed, to slide along columns
+};
+
+class TileStore {
+private:
+	// Cached tiles, by tileRow*tilesPerSide + tileCol, most recently used first
+	struct CacheEntry {
+		std::shared_ptr<const MazeTile> tile;
+		std::list<long>::iterator used;
+	};
+
+	std::string path;
+	int fd;
+	int mazeSize, tilesPerSide;
+	int goalRow, goalCol;
+	int startRow, startCol;
+
+	std::mutex cacheMutex;
+	std::unordered_map<long, CacheEntry> cache;
+	std::list<long> recentlyUsed;
+	long hits, misses, prefetched, evicted;
+	bool damageReported;
+
+	// Read ahead requests for the I/O thread
+	std::deque<long> requests;
+	std::condition_variable requested;
+	std::thread ioThread;
+	bool stopping;
+
+	std::shared_ptr<MazeTile> readTile(long index);
+	void insert(long index, std::shared_ptr<const MazeTile> tile);
+	void ioLoop();
+
+	int nextBlock(bool alongRow, int line, int from);
+	int previousBlock(bool alongRow, int line, int from);
+
+public:
+	TileStore();
+	~TileStore();
+	TileStore(const TileStore &) = delete;
+	TileStore &operator=(const TileStore &) = delete;
+
+	bool open(const char *path, std::string &error);
+
+	int size() const {
+		return mazeSize;
+	}
+
+	int getTilesPerSide() const {
+		return tilesPerSide;
+	}
+
+	int getGoalRow() const;
+	int getGoalCol() const;
+	int getStartRow() const;
+	int getStartCol() const;
+
+	std::shared_ptr<const MazeTile> getTile(int tileRow, int tileCol);
+	void prefetch(int tileRow, int tileCol);
+
+	bool isBlock(int row, int col);
+	void slide(int direction, int &row, int &col);
+	void copyWindow(int firstRow, int firstCol, int size, MazeGrid &window);
+
+	long getHits();
+	long getMisses();
+	long getPrefetched();
+	long getEvicted();
+};
+
+/**
+ * Write a tiled maze one band of TILE_SIZE rows at a time, so mazes much
+ * bigger than memory can be written.
+ */
+class TileWriter {
+private:
+	std::string path;
+	FILE *file;
+	int mazeSize, tilesPerSide;
+	int bandsWritten;
+	bool failed;
+	std::vector<uint64_t> record;
+
+public:
+	TileWriter();
+	~TileWriter();
+
+	bool open(const char *path, int size, int goalRow, int goalCol, int startRow, int startCol,
+		std::string &error);
+	void writeBand(const uint64_t *rows);
+	bool close(std::string &error);
+};
+
+bool isMazeTiled(const void *data, size_t length);
+bool isMazeTiledFile(const char *path);
+bool writeMazeTiled(const char *path, const MazeGrid &grid, std::string &error);
+
+#endif
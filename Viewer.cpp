@@ -42,13 +42,14 @@ void ObjectViewer::reset() {
 /**
  * Check state of user input, use it to update view matrix
  * Allow rotation about the y axis from horizontal mouse movement
+ * @return true if the view matrix changed
  */
-void ObjectViewer::update(InputState &input) {
+bool ObjectViewer::update(InputState &input) {
 	float xRot;
 	input.readDeltaAndReset( &xRot );
 	
 	// Rotate about the eye's y axis.
-	if ( input.lMousePressed )
+	if ( input.lMousePressed && xRot != 0.0f )
 	{
 		glm::vec3 yAxis = glm::vec3(0.0f, 1.0f, 0.0f);
 
@@ -56,7 +57,10 @@ void ObjectViewer::update(InputState &input) {
 		cumulativeRotation += rotation;
 
 		viewMtx = glm::rotate(viewMtx, rotation, yAxis);
+		return true;
 	}
+
+	return false;
 }
 
 /**
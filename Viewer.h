@@ -19,7 +19,7 @@ private:
 public:
 	ObjectViewer( glm::vec3 eye );
 
-	void update( InputState &input);
+	bool update( InputState &input);
 	float getCameraRotation();
 
 	const glm::mat4 getViewMtx() const;
@@ -0,0 +1,374 @@
+/**
+ * Microbenchmark for sliding the ball through the grid.
+ * Compares four ways of finding where a slide stops, on the same random
+ * starting squares and directions:
+ *  - strings: one std::string per row, checked one square at a time with
+ *    grid.at(row)[col], as the game used to store the maze
+ *  - cells: the bitmap, checked one square at a time
+ *  - bitscan: MazeGrid::slide() without a slide table, which skips 64
+ *    squares at a time
+ *  - table: MazeGrid::slide() with a slide table, one lookup per slide, for
+ *    mazes up to SLIDE_TABLE_MAX_SIZE. The time to build the table is
+ *    reported too.
+ * Every method must stop in the same squares, otherwise the run fails.
+ *
+ * With --solve, times the solvers instead: SOLVER_BFS, SOLVER_ASTAR and
+ * SOLVER_BIDIRECTIONAL, then SOLVER_PARALLEL_BFS with 1 thread up to
+ * --max-threads, which defaults to one per core. Every solver must find the
+ * same number of moves.
+ *
+ * Usage: maze-bench [--slides N] [--solve [--max-threads N]] [mazeFile ...]
+ * Without maze files, random mazes of several sizes and densities are used.
+ * Prints one line of JSON per maze.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Direction.h"
+#include "MazeGrid.h"
+#include "MazeLoader.h"
+#include "Solver.h"
+
+#define DEFAULT_SLIDES 1000000
+
+struct Slide {
+	int row, col, direction;
+};
+
+/**
+ * Fill a grid with random blocks, with the goal and start left free
+ * @param grid Grid to fill
+ * @param size Number of rows and columns
+ * @param density Chance of each square being a block
+ * @param seed Random seed
+ */
+void randomGrid(MazeGrid &grid, int size, double density, unsigned int seed) {
+	std::mt19937 random(seed);
+	std::bernoulli_distribution block(density);
+
+	uint64_t *words = grid.allocate(size);
+	int wordsPerRow = grid.getWordsPerRow();
+	for (int row = 0; row < size; row++) {
+		for (int col = 0; col < size; col++) {
+			if (block(random)) {
+				words[(long)row * wordsPerRow + col/64] |= 1ull << (col % 64);
+			}
+		}
+	}
+
+	words[0] &= ~1ull;
+	grid.setGoal(size - 1, size - 1);
+	words[(long)(size - 1) * wordsPerRow + (size - 1)/64] &= ~(1ull << ((size - 1) % 64));
+	grid.buildColumns();
+}
+
+/**
+ * Pick random free squares to slide from, in random directions
+ */
+std::vector<Slide> randomSlides(const MazeGrid &grid, int count, unsigned int seed) {
+	std::mt19937 random(seed);
+	std::uniform_int_distribution<int> square(0, grid.size() - 1);
+	std::uniform_int_distribution<int> direction(0, DIRECTION_COUNT - 1);
+
+	std::vector<Slide> slides(count);
+	for (int i = 0; i < count; i++) {
+		do {
+			slides[i].row = square(random);
+			slides[i].col = square(random);
+		} while (grid.isBlock(slides[i].row, slides[i].col));
+		slides[i].direction = direction(random);
+	}
+	return slides;
+}
+
+/**
+ * Slide one square at a time through rows stored as strings
+ */
+void slideStrings(const std::vector<std::string> &grid, int direction, int &row, int &col) {
+	int gridSize = grid.size();
+	switch (direction) {
+		case NORTH:
+			while (row > 0 && grid.at(row-1)[col] != '*') {
+				row--;
+			}
+			break;
+		case SOUTH:
+			while (row < gridSize-1 && grid.at(row+1)[col] != '*') {
+				row++;
+			}
+			break;
+		case EAST:
+			while (col < gridSize-1 && grid.at(row)[col+1] != '*') {
+				col++;
+			}
+			break;
+		case WEST:
+			while (col > 0 && grid.at(row)[col-1] != '*') {
+				col--;
+			}
+			break;
+	}
+}
+
+/**
+ * Slide one square at a time through the bitmap
+ */
+void slideCells(const MazeGrid &grid, int direction, int &row, int &col) {
+	int gridSize = grid.size();
+	switch (direction) {
+		case NORTH:
+			while (row > 0 && !grid.isBlock(row-1, col)) {
+				row--;
+			}
+			break;
+		case SOUTH:
+			while (row < gridSize-1 && !grid.isBlock(row+1, col)) {
+				row++;
+			}
+			break;
+		case EAST:
+			while (col < gridSize-1 && !grid.isBlock(row, col+1)) {
+				col++;
+			}
+			break;
+		case WEST:
+			while (col > 0 && !grid.isBlock(row, col-1)) {
+				col--;
+			}
+			break;
+	}
+}
+
+/**
+ * Time one way of sliding over every slide
+ * @param method 0 for strings, 1 for cells, 2 for bitscan or table, depending
+ *        on whether the grid has a slide table
+ * @param stops Set to the square each slide stopped in, row*size + col
+ * @return Nanoseconds per slide
+ */
+double timeSlides(int method, const MazeGrid &grid, const std::vector<std::string> &strings,
+	const std::vector<Slide> &slides, std::vector<long> &stops) {
+
+	stops.resize(slides.size());
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (size_t i = 0; i < slides.size(); i++) {
+		int row = slides[i].row;
+		int col = slides[i].col;
+		if (method == 0) {
+			slideStrings(strings, slides[i].direction, row, col);
+		} else if (method == 1) {
+			slideCells(grid, slides[i].direction, row, col);
+		} else {
+			grid.slide(slides[i].direction, row, col);
+		}
+		stops[i] = (long)row * grid.size() + col;
+	}
+	std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+
+	return elapsed.count() / slides.size();
+}
+
+/**
+ * Run every method on one maze and print the results
+ * @return false if the methods disagree
+ */
+bool benchGrid(const char *name, MazeGrid &grid, int slideCount) {
+	int size = grid.size();
+
+	std::vector<std::string> strings(size, std::string(size, ' '));
+	for (int row = 0; row < size; row++) {
+		for (int col = 0; col < size; col++) {
+			if (grid.isBlock(row, col)) {
+				strings[row][col] = '*';
+			}
+		}
+	}
+
+	std::vector<Slide> slides = randomSlides(grid, slideCount, 1);
+
+	std::vector<long> expected, stops;
+	double stringsNs = timeSlides(0, grid, strings, slides, expected);
+	double cellsNs = timeSlides(1, grid, strings, slides, stops);
+	bool same = stops == expected;
+	double bitscanNs = timeSlides(2, grid, strings, slides, stops);
+	same = same && stops == expected;
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	grid.buildSlideTable();
+	std::chrono::duration<double, std::milli> buildTime = std::chrono::steady_clock::now() - start;
+
+	// Mazes too big for a slide table report null
+	char tableNs[32] = "null";
+	char tableBuildMs[32] = "null";
+	if (grid.hasSlideTable()) {
+		snprintf(tableNs, sizeof(tableNs), "%.1f", timeSlides(2, grid, strings, slides, stops));
+		snprintf(tableBuildMs, sizeof(tableBuildMs), "%.1f", buildTime.count());
+		same = same && stops == expected;
+	}
+
+	// Average number of squares moved, slides are longer in sparse mazes
+	double distance = 0.0;
+	for (size_t i = 0; i < slides.size(); i++) {
+		long from = (long)slides[i].row * size + slides[i].col;
+		long moved = expected[i] - from;
+		distance += (moved < 0 ? -moved : moved) / ((slides[i].direction == NORTH || slides[i].direction == SOUTH) ? size : 1);
+	}
+	distance /= slides.size();
+
+	printf("{\"maze\": \"%s\", \"size\": %d, \"slides\": %d, \"meanSlideLength\": %.1f, "
+		"\"nsPerSlide\": {\"strings\": %.1f, \"cells\": %.1f, \"bitscan\": %.1f, \"table\": %s}, \"tableBuildMs\": %s, \"match\": %s}\n",
+		name, size, slideCount, distance, stringsNs, cellsNs, bitscanNs, tableNs, tableBuildMs, same ? "true" : "false");
+	fflush(stdout);
+
+	return same;
+}
+
+/**
+ * Time one solver on a maze
+ * @param milliseconds Set to how long it took
+ */
+void timeSolver(const MazeGrid &grid, int solver, Solution &solution, double &milliseconds) {
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	solveMaze(grid, solver, solution);
+	std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+	milliseconds = elapsed.count();
+}
+
+/**
+ * Run every solver on one maze and print the results
+ * @param maxThreads Most threads to run the parallel solver with
+ * @return false if the solvers disagree
+ */
+bool benchSolvers(const char *name, const MazeGrid &grid, int maxThreads) {
+	Solution expected;
+	double bfsMs;
+	timeSolver(grid, SOLVER_BFS, expected, bfsMs);
+	bool same = !expected.solved || checkSolution(grid, expected.moves);
+
+	// Searches for single questions, each on one thread
+	int pointSolvers[] = {SOLVER_ASTAR, SOLVER_BIDIRECTIONAL};
+	std::string point;
+	for (int solver : pointSolvers) {
+		Solution solution;
+		double milliseconds;
+		timeSolver(grid, solver, solution, milliseconds);
+		same = same && solution.solved == expected.solved && solution.moves.size() == expected.moves.size() &&
+			(!solution.solved || checkSolution(grid, solution.moves));
+
+		char result[128];
+		snprintf(result, sizeof(result), ", \"%s\": {\"ms\": %.1f, \"statesExpanded\": %ld}",
+			getSolverName(solver), milliseconds, solution.statesExpanded);
+		point += result;
+	}
+
+	std::string parallel;
+	for (int threads = 1; threads <= maxThreads; threads++) {
+		Solution solution;
+		double milliseconds;
+		setSolverThreads(threads);
+		timeSolver(grid, SOLVER_PARALLEL_BFS, solution, milliseconds);
+		same = same && solution.solved == expected.solved && solution.moves.size() == expected.moves.size() &&
+			(!solution.solved || checkSolution(grid, solution.moves));
+
+		char result[128];
+		snprintf(result, sizeof(result), "%s{\"threads\": %d, \"ms\": %.1f, \"speedup\": %.2f, \"statesExpanded\": %ld}",
+			threads > 1 ? ", " : "", threads, milliseconds, bfsMs / milliseconds, solution.statesExpanded);
+		parallel += result;
+	}
+	setSolverThreads(0);
+
+	printf("{\"maze\": \"%s\", \"size\": %d, \"moves\": %d, \"bfs\": {\"ms\": %.1f, \"statesExpanded\": %ld}%s, "
+		"\"parallel-bfs\": [%s], \"match\": %s}\n",
+		name, grid.size(), expected.solved ? (int)expected.moves.size() : -1, bfsMs, expected.statesExpanded,
+		point.c_str(), parallel.c_str(), same ? "true" : "false");
+	fflush(stdout);
+
+	return same;
+}
+
+int main(int argc, char **argv) {
+	int slideCount = DEFAULT_SLIDES;
+	bool solve = false;
+	int maxThreads = std::max(1, (int)std::thread::hardware_concurrency());
+	std::vector<const char*> paths;
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--slides") == 0 && i+1 < argc) {
+			slideCount = atoi(argv[++i]);
+			if (slideCount < 1) {
+				printf("Please enter a number of slides >= 1.\n");
+				return 1;
+			}
+		} else if (strcmp(argv[i], "--solve") == 0) {
+			solve = true;
+		} else if (strcmp(argv[i], "--max-threads") == 0 && i+1 < argc) {
+			maxThreads = atoi(argv[++i]);
+			if (maxThreads < 1) {
+				printf("Please enter a number of threads >= 1.\n");
+				return 1;
+			}
+		} else if (argv[i][0] != '-') {
+			paths.push_back(argv[i]);
+		} else {
+			printf("Usage: maze-bench [--slides N] [--solve [--max-threads N]] [mazeFile ...]\n");
+			return 1;
+		}
+	}
+
+	bool same = true;
+	if (paths.empty() && solve) {
+		int sizes[] = {1024, 4096, 10000};
+		double densities[] = {0.1, 0.03};
+		for (int size : sizes) {
+			for (double density : densities) {
+				MazeGrid grid;
+				randomGrid(grid, size, density, size);
+
+				char name[64];
+				snprintf(name, sizeof(name), "random %dx%d, %g blocks", size, size, density);
+				same = benchSolvers(name, grid, maxThreads) && same;
+			}
+		}
+	} else if (paths.empty()) {
+		int sizes[] = {1024, 4096, 16384};
+		double densities[] = {0.3, 0.03, 0.003};
+		for (int size : sizes) {
+			for (double density : densities) {
+				MazeGrid grid;
+				randomGrid(grid, size, density, size);
+
+				char name[64];
+				snprintf(name, sizeof(name), "random %dx%d, %g blocks", size, size, density);
+				same = benchGrid(name, grid, slideCount) && same;
+			}
+		}
+	}
+
+	for (const char *path : paths) {
+		MazeGrid grid;
+		std::string error;
+		if (!loadMazeFile(path, grid, error)) {
+			printf("Invalid maze file: %s\n", error.c_str());
+			return 1;
+		}
+		if (solve) {
+			same = benchSolvers(path, grid, maxThreads) && same;
+		} else {
+			same = benchGrid(path, grid, slideCount) && same;
+		}
+	}
+
+	if (!same) {
+		printf(solve ? "Solvers found different numbers of moves\n" : "Slides stopped in different squares\n");
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,84 @@
+/**
+ * Convert a maze file between the text and binary formats.
+ * Text mazes are written as binary, and binary mazes as text.
+ * With --tiled, either is written in the tiled format instead.
+ *
+ * Usage: maze-convert [--tiled] input output
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#include <sys/stat.h>
+
+#include "MazeBinary.h"
+#include "MazeGrid.h"
+#include "MazeLoader.h"
+#include "TileStore.h"
+
+/**
+ * @return Size of a file in bytes, or -1 if it can't be read
+ */
+long fileSize(const char *path) {
+	struct stat info;
+	if (stat(path, &info) != 0) {
+		return -1;
+	}
+	return info.st_size;
+}
+
+/**
+ * @return true if the file starts with the binary maze magic number
+ */
+bool isBinaryFile(const char *path) {
+	char magic[MAZE_BINARY_MAGIC_SIZE];
+	FILE *file = fopen(path, "rb");
+	if (file == NULL) {
+		return false;
+	}
+	size_t read = fread(magic, 1, sizeof(magic), file);
+	fclose(file);
+	return isMazeBinary(magic, read);
+}
+
+int main(int argc, char **argv) {
+	bool tiled = argc == 4 && strcmp(argv[1], "--tiled") == 0;
+	if (argc != 3 && !tiled) {
+		printf("Usage: maze-convert [--tiled] input output\n");
+		printf("Text mazes are converted to binary, and binary mazes to text.\n");
+		printf("With --tiled, either is converted to the tiled format.\n");
+		return 1;
+	}
+
+	const char *inputPath = argv[argc - 2];
+	const char *outputPath = argv[argc - 1];
+
+	MazeGrid grid;
+	std::string error;
+	if (!loadMazeFile(inputPath, grid, error)) {
+		printf("Invalid maze file: %s\n", error.c_str());
+		return 1;
+	}
+
+	const char *format;
+	bool written;
+	if (tiled) {
+		format = "tiled";
+		written = writeMazeTiled(outputPath, grid, error);
+	} else if (isBinaryFile(inputPath)) {
+		format = "text";
+		written = writeMazeText(outputPath, grid, error);
+	} else {
+		format = "binary";
+		written = writeMazeBinary(outputPath, grid, error);
+	}
+	if (!written) {
+		printf("Couldn't write maze: %s\n", error.c_str());
+		return 1;
+	}
+
+	printf("%s (%ld bytes) -> %s %s (%ld bytes), %dx%d\n", inputPath, fileSize(inputPath),
+		format, outputPath, fileSize(outputPath), grid.size(), grid.size());
+	return 0;
+}
@@ -0,0 +1,301 @@
+/**
+ * Generate random mazes that take a chosen number of moves to solve.
+ * Each candidate maze gets random blocks at the given density, then a
+ * breadth first search from the top left square finds every square the
+ * ball can stop in after exactly that many moves, and the goal is put on
+ * one of them. Candidates where no square is that far away are dropped.
+ *
+ * Candidates are tried on several threads at once. Each one's random
+ * numbers only depend on the seed and its index, and the lowest index that
+ * works is kept, so a seed always gives the same maze whatever the number
+ * of threads. Blocks and goals come straight from the numbers of
+ * std::mt19937_64, which the standard fixes, not through the std::
+ * distributions, which it doesn't, so it is the same with any compiler too.
+ * The maze is checked with the solver before it is written.
+ *
+ * Usage: maze-gen [--seed S] [--size N] [--density D] [--moves M]
+ *	[--candidates K] [--threads T] [--binary | --tiled] output
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Direction.h"
+#include "MazeBinary.h"
+#include "MazeGrid.h"
+#include "MazeLoader.h"
+#include "Solver.h"
+#include "TileStore.h"
+
+#define DEFAULT_SIZE 64
+#define DEFAULT_DENSITY 0.2
+#define DEFAULT_MOVES 20
+#define DEFAULT_CANDIDATES 256
+// Biggest maze generated, the size levels are played at
+#define MAZE_GEN_MAX_SIZE 4096
+
+#define OUTPUT_TEXT 0
+#define OUTPUT_BINARY 1
+#define OUTPUT_TILED 2
+
+/**
+ * Candidates shared between the generating threads
+ */
+struct Generation {
+	unsigned int seed;
+	int size;
+	double density;
+	int moves;
+	int candidates;
+
+	std::atomic<int> nextCandidate;
+	std::mutex bestMutex;
+	int bestCandidate;	// lowest index that worked so far, candidates if none
+	MazeGrid best;
+};
+
+/**
+ * Pick a random number below a limit, each as likely as the others
+ * Done by hand, as the std:: distributions give different numbers with
+ * different standard libraries, and the same seed must give the same maze.
+ */
+uint64_t pickBelow(std::mt19937_64 &random, uint64_t limit) {
+	// Numbers below 2^64 % limit are skipped, or the lowest results would come up more often
+	uint64_t skipped = (0 - limit) % limit;
+	uint64_t number = random();
+	while (number < skipped) {
+		number = random();
+	}
+	return number % limit;
+}
+
+/**
+ * Fill a grid with random blocks, leaving the start free
+ * A square is a block when the top 53 bits of its random number, as a
+ * fraction of 1, are below the density.
+ */
+void placeBlocks(MazeGrid &grid, int size, double density, std::mt19937_64 &random) {
+	uint64_t threshold = (uint64_t)(density * (double)(1ull << 53));
+
+	uint64_t *words = grid.allocate(size);
+	int wordsPerRow = grid.getWordsPerRow();
+	for (int row = 0; row < size; row++) {
+		for (int col = 0; col < size; col++) {
+			if ((random() >> 11) < threshold) {
+				words[(long)row * wordsPerRow + col/64] |= 1ull << (col % 64);
+			}
+		}
+	}
+	words[0] &= ~1ull;
+	grid.buildColumns();
+}
+
+/**
+ * Find the squares the ball can stop in after exactly some number of moves
+ * from the start, and no fewer
+ * @param grid Maze, with its columns built
+ * @param moves Number of moves
+ * @return The squares, row*size + col, empty if nothing is that far away
+ */
+std::vector<long> findSquaresAt(const MazeGrid &grid, int moves) {
+	int size = grid.size();
+	std::vector<uint64_t> visited(((long)size * size + 63) / 64, 0);
+
+	long start = (long)grid.getStartRow() * size + grid.getStartCol();
+	std::vector<long> frontier(1, start);
+	std::vector<long> next;
+	visited[start >> 6] |= 1ull << (start & 63);
+
+	for (int move = 0; move < moves && !frontier.empty(); move++) {
+		next.clear();
+		for (int i = 0; i < frontier.size(); i++) {
+			for (int direction = 0; direction < DIRECTION_COUNT; direction++) {
+				int row = frontier[i] / size;
+				int col = frontier[i] % size;
+				grid.slide(direction, row, col);
+
+				long stop = (long)row * size + col;
+				if (((visited[stop >> 6] >> (stop & 63)) & 1) == 0) {
+					visited[stop >> 6] |= 1ull << (stop & 63);
+					next.push_back(stop);
+				}
+			}
+		}
+		frontier.swap(next);
+	}
+
+	// Found in breadth first order, sort so the goal picked doesn't depend on it
+	std::sort(frontier.begin(), frontier.end());
+	return frontier;
+}
+
+/**
+ * Make one candidate maze
+ * @param index Which candidate, which seeds its random numbers with the generation's seed
+ * @param grid Set to the maze, if it works
+ * @return true if the maze takes exactly the number of moves wanted
+ */
+bool makeCandidate(Generation &generation, int index, MazeGrid &grid) {
+	std::seed_seq seeds = { generation.seed, (unsigned int)index };
+	std::mt19937_64 random(seeds);
+
+	placeBlocks(grid, generation.size, generation.density, random);
+	grid.setStart(0, 0);
+
+	std::vector<long> goals = findSquaresAt(grid, generation.moves);
+	if (goals.empty()) {
+		return false;
+	}
+
+	long goal = goals[pickBelow(random, goals.size())];
+	grid.setGoal(goal / generation.size, goal % generation.size);
+	return true;
+}
+
+/**
+ * Try candidates until one works
+ * Candidates after the best one found so far are skipped, but every one
+ * before it is still tried, so the lowest index that works is kept.
+ */
+void generateCandidates(Generation *generation) {
+	while (true) {
+		int index = generation->nextCandidate++;
+		{
+			std::lock_guard<std::mutex> lock(generation->bestMutex);
+			if (index >= generation->bestCandidate) {
+				return;
+			}
+		}
+
+		MazeGrid grid;
+		if (!makeCandidate(*generation, index, grid)) {
+			continue;
+		}
+
+		std::lock_guard<std::mutex> lock(generation->bestMutex);
+		if (index < generation->bestCandidate) {
+			generation->bestCandidate = index;
+			generation->best = std::move(grid);
+		}
+	}
+}
+
+/**
+ * Print how to use the generator
+ */
+void printUsage() {
+	printf("Usage: maze-gen [--seed S] [--size N] [--density D] [--moves M] "
+		"[--candidates K] [--threads T] [--binary | --tiled] output\n");
+	printf("Writes a random maze that takes exactly M moves from the top left square to solve,\n");
+	printf("in the text format unless --binary or --tiled is given. Sizes go up to %d.\n", MAZE_GEN_MAX_SIZE);
+}
+
+int main(int argc, char **argv) {
+	Generation generation;
+	generation.seed = 1;
+	generation.size = DEFAULT_SIZE;
+	generation.density = DEFAULT_DENSITY;
+	generation.moves = DEFAULT_MOVES;
+	generation.candidates = DEFAULT_CANDIDATES;
+	int threadCount = std::max(1, (int)std::thread::hardware_concurrency());
+	int format = OUTPUT_TEXT;
+	const char *outputPath = NULL;
+
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--seed") == 0 && i+1 < argc) {
+			generation.seed = strtoul(argv[++i], NULL, 10);
+		} else if (strcmp(argv[i], "--size") == 0 && i+1 < argc) {
+			generation.size = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "--density") == 0 && i+1 < argc) {
+			generation.density = atof(argv[++i]);
+		} else if (strcmp(argv[i], "--moves") == 0 && i+1 < argc) {
+			generation.moves = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "--candidates") == 0 && i+1 < argc) {
+			generation.candidates = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "--threads") == 0 && i+1 < argc) {
+			threadCount = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "--binary") == 0) {
+			format = OUTPUT_BINARY;
+		} else if (strcmp(argv[i], "--tiled") == 0) {
+			format = OUTPUT_TILED;
+		} else if (outputPath == NULL && argv[i][0] != '-') {
+			outputPath = argv[i];
+		} else {
+			printUsage();
+			return 1;
+		}
+	}
+
+	if (outputPath == NULL) {
+		printUsage();
+		return 1;
+	}
+	if (generation.size < 2 || generation.size > MAZE_GEN_MAX_SIZE) {
+		printf("Please enter a size from 2 to %d.\n", MAZE_GEN_MAX_SIZE);
+		return 1;
+	}
+	if (generation.density < 0.0 || generation.density >= 1.0) {
+		printf("Please enter a density >= 0 and < 1.\n");
+		return 1;
+	}
+	if (generation.moves < 1 || generation.candidates < 1 || threadCount < 1) {
+		printf("Please enter a number of moves, candidates and threads >= 1.\n");
+		return 1;
+	}
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	generation.nextCandidate = 0;
+	generation.bestCandidate = generation.candidates;
+	std::vector<std::thread> threads;
+	for (int i = 0; i < threadCount; i++) {
+		threads.push_back(std::thread(generateCandidates, &generation));
+	}
+	for (int i = 0; i < threads.size(); i++) {
+		threads[i].join();
+	}
+
+	if (generation.bestCandidate == generation.candidates) {
+		printf("None of %d candidates takes %d moves, try a different density or more candidates\n",
+			generation.candidates, generation.moves);
+		return 1;
+	}
+
+	// Check it the way the game plays it
+	MazeGrid &grid = generation.best;
+	Solution solution;
+	if (!solveMaze(grid, SOLVER_BFS, solution) || solution.moves.size() != generation.moves ||
+		!checkSolution(grid, solution.moves)) {
+		printf("Candidate %d doesn't take %d moves to solve\n", generation.bestCandidate, generation.moves);
+		return 1;
+	}
+
+	std::string error;
+	bool written;
+	if (format == OUTPUT_TILED) {
+		written = writeMazeTiled(outputPath, grid, error);
+	} else if (format == OUTPUT_BINARY) {
+		written = writeMazeBinary(outputPath, grid, error);
+	} else {
+		written = writeMazeText(outputPath, grid, error);
+	}
+	if (!written) {
+		printf("Couldn't write maze: %s\n", error.c_str());
+		return 1;
+	}
+
+	std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+	printf("%s: %dx%d, %.1f%% blocks, %d moves, seed %u candidate %d, in %.0f ms on %d thread%s\n",
+		outputPath, grid.size(), grid.size(), 100.0 * grid.countBlocks() / ((long)grid.size() * grid.size()),
+		generation.moves, generation.seed, generation.bestCandidate, elapsed.count(), threadCount, threadCount == 1 ? "" : "s");
+	return 0;
+}
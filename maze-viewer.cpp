@@ -4,10 +4,18 @@
  * Based on model-view example from lectures
  */
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
-#include <fstream>
+#include <mutex>
 #include <sstream>
 #include <string>
+#include <thread>
+#include <utility>
+#include <vector>
 
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
@@ -16,11 +24,18 @@
 #include "glm/gtc/matrix_transform.hpp"
 #include "glm/gtc/type_ptr.hpp"
 
-#include "GameManager.h"
-#include "InputState.h"
-#include "Viewer.h"
+#include "Direction.h"
+#include "DistanceField.h"
+#include "FileWatcher.h"
+#include "FrameCapture.h"
+#include "Headless.h"
 #include "Maze.h"
+#include "MazeLoader.h"
+#include "Profiler.h"
 #include "Shader.hpp"
+#include "Simulation.h"
+#include "Solver.h"
+#include "TileStore.h"
 
 // Window created with GLFW
 int winX = 640;
@@ -29,18 +44,88 @@ GLFWwindow *window;
 
 // The maze and related objects.
 float mazeWidth = 10.0f;
+MazeGrid mazeGrid;	// loaded before the window opens, then moved into the maze
+DistanceField mazeDistances;	// moves to the goal from each square of mazeGrid
+TileStore *tileStore = NULL;	// tiled mazes are paged in from here instead
 Maze *maze;
 
-GameManager *gameManager;
+// Game logic and camera, stepped on their own thread
+Simulation *simulation;
+
+// Frames are drawn on their own thread, so slow frames don't hold up input.
+// The main thread only handles window events and passes them on.
+std::thread renderThread;
+std::atomic<bool> rendering(false);
+
+// Requests from the main thread, handled by the render thread before its next frame
+std::atomic<bool> resizeRequested(false);
+std::atomic<int> requestedWinX(0), requestedWinY(0);
+std::atomic<bool> renderModeChangeRequested(false);
+std::atomic<bool> profilerToggleRequested(false);
+std::atomic<bool> occlusionToggleRequested(false);
+
+// The maze file is watched while playing, and an edited maze replaces the
+// loaded one on the render thread. Set by the watcher so the main thread
+// asks for a new frame, and by the render thread once the maze is replaced
+// so the main thread has the simulation check the ball against it.
+FileWatcher *mazeWatcher = NULL;
+std::mutex reloadMutex;
+MazeGrid reloadedGrid;
+DistanceField reloadedDistances;
+bool reloadReady = false;
+std::atomic<bool> reloadRedrawRequested(false);
+std::atomic<bool> reloadApplied(false);
+
+// Window title from the render thread, set by the main thread (GLFW requires it)
+std::mutex titleMutex;
+std::string pendingTitle;
+bool titleChanged = false;
+
+// Command line options
+char *mazePath = NULL;
+int benchFrames = 0;	// render this many offscreen frames and exit, if > 0
+bool onDemand = false;	// only draw a frame when something changed
+bool solveOnly = false;	// print the fewest moves to the goal and exit, without a window
+int solver = SOLVER_BFS;
+
+// Render on demand: longest time the render thread sleeps before checking if it should stop
+#define ON_DEMAND_TIMEOUT 0.5
+int framesDrawn = 0;
+
+// Shader program for each render stage, variants of maze.vert and maze.frag
+unsigned int programIDs[RENDER_STAGE_COUNT];
+glm::mat4 projection;
+
+// Uniform buffer holding the projection and view matrices (Camera block in maze.vert)
+#define CAMERA_BLOCK_BINDING 0
+unsigned int cameraBufferHandle;
+glm::mat4 viewMatrix;
+// Set when the projection or view matrix changes, so the maze can re-cull its chunks
+bool cameraChanged = true;
+
+// Static world chunks drawn and culled, shown in the window title
+int titleChunksDrawn = -1;
+int titleChunksCulled = -1;
+int titleOccluded = -1;
+
+// Frame timings, shown in the window title when profiling is turned on
+Profiler *profiler;
+char *profileCsvPath = NULL;	// also write every profiled frame to this file
+
+// Every frame drawn is written to an image sequence in this directory, if set
+char *captureDir = NULL;
+FrameCapture *frameCapture = NULL;
+#define PROFILE_TITLE_INTERVAL 0.25	// seconds between title updates
+double profileTitleTime = 0.0;
 
-ObjectViewer *camera;
-
-// Data structure storing mouse input info
-InputState Input;
-
-// Shader program
-unsigned int programID;
-int viewHandle;
+/**
+ * Make sure another frame is drawn, even in on-demand mode.
+ * Only call from the main thread, which is the one allowed to post input.
+ */
+void requestRedraw() {
+	InputEvent event = { INPUT_EVENT_REDRAW, 0, 0.0f, false };
+	simulation->post(event);
+}
 
 // GLFW callback: Keyboard game controls
 void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods) {
@@ -54,7 +139,28 @@ void key_callback(GLFWwindow* window, int key, int scancode, int action, int mod
 			case GLFW_KEY_UP:
 			case GLFW_KEY_LEFT:
 			case GLFW_KEY_DOWN:
-				gameManager->moveBall(key, camera->getCameraRotation());
+				{
+					InputEvent event = { INPUT_EVENT_KEY, key, 0.0f, false };
+					simulation->post(event);
+				}
+				break;
+			case GLFW_KEY_H:
+				{
+					InputEvent event = { INPUT_EVENT_HINT, key, 0.0f, false };
+					simulation->post(event);
+				}
+				break;
+			case GLFW_KEY_R:
+				renderModeChangeRequested = true;
+				requestRedraw();
+				break;
+			case GLFW_KEY_P:
+				profilerToggleRequested = true;
+				requestRedraw();
+				break;
+			case GLFW_KEY_O:
+				occlusionToggleRequested = true;
+				requestRedraw();
 				break;
 			default:
 				break;
@@ -62,17 +168,17 @@ void key_callback(GLFWwindow* window, int key, int scancode, int action, int mod
 	}
 }	
 
-// GLFW callback: Store mouse position info
+// GLFW callback: Pass mouse position to the simulation
 void mouse_pos_callback(GLFWwindow* window, double x, double y) {
-	Input.update((float)x);
+	InputEvent event = { INPUT_EVENT_MOUSE_MOVE, 0, (float)x, false };
+	simulation->post(event);
 }
 
-// GLFW callback: Store mouse button info
+// GLFW callback: Pass mouse button state to the simulation
 void mouse_button_callback(GLFWwindow* window, int button, int action, int mods) {
-	if (button == GLFW_MOUSE_BUTTON_LEFT && action == GLFW_PRESS) {
-		Input.lMousePressed = true;
-	} else if (button == GLFW_MOUSE_BUTTON_LEFT && action == GLFW_RELEASE) {
-		Input.lMousePressed = false;
+	if (button == GLFW_MOUSE_BUTTON_LEFT && (action == GLFW_PRESS || action == GLFW_RELEASE)) {
+		InputEvent event = { INPUT_EVENT_MOUSE_BUTTON, 0, 0.0f, action == GLFW_PRESS };
+		simulation->post(event);
 	}
 }
 
@@ -81,25 +187,38 @@ void mouse_button_callback(GLFWwindow* window, int button, int action, int mods)
  * when the window is resized.
  */
 void setProjection() {
-	glm::mat4 projection;
-	
 	projection = glm::perspective( (float)M_PI/3.0f, (float) winX / winY, 1.0f, 30.0f );
 
-	// Load it to the shader program
-	int projHandle = glGetUniformLocation(programID, "projection");
-	if (projHandle == -1) {
-		std::cout << "Uniform: projection_matrix is not an active uniform label\n";
-	}
-	// upload our projection matrix to shader
-	glUniformMatrix4fv( projHandle, 1, false, glm::value_ptr(projection) );
+	// upload our projection matrix to the camera uniform buffer
+	glBindBuffer(GL_UNIFORM_BUFFER, cameraBufferHandle);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(glm::mat4), glm::value_ptr(projection));
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+	cameraChanged = true;
+}
+
+/*
+ * Upload the view matrix from the camera. Only called when the camera has moved.
+ * @param view View matrix from the latest simulation snapshot
+ */
+void setView(glm::mat4 view) {
+	viewMatrix = view;
+
+	// view matrix follows the projection matrix in the camera uniform buffer
+	glBindBuffer(GL_UNIFORM_BUFFER, cameraBufferHandle);
+	glBufferSubData(GL_UNIFORM_BUFFER, sizeof(glm::mat4), sizeof(glm::mat4), glm::value_ptr(viewMatrix));
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+	cameraChanged = true;
 }
 
 // GLFW callback: Called when the window is resized.
+// The render thread owns the OpenGL context, so it applies the new size.
 void reshape_callback( GLFWwindow *window, int x, int y ) {
-	winX = x;
-	winY = y;
-	setProjection();
-	glViewport( 0, 0, x, y );
+	requestedWinX = x;
+	requestedWinY = y;
+	resizeRequested = true;
+	requestRedraw();
 }
 
 // GLFW callback: Error. Simply prints error message to stderr.
@@ -108,46 +227,201 @@ static void error_callback(int error, const char* description) {
 }
 
 /**
- * Render frame
+ * Apply requests made by the main thread since the last frame
+ */
+void handleRequests() {
+	if (resizeRequested.exchange(false)) {
+		winX = requestedWinX;
+		winY = requestedWinY;
+		setProjection();
+		glViewport( 0, 0, winX, winY );
+	}
+
+	if (renderModeChangeRequested.exchange(false)) {
+		maze->cycleRenderMode();
+		std::cout << "Render mode: " << maze->getRenderModeName() << std::endl;
+	}
+
+	if (occlusionToggleRequested.exchange(false)) {
+		maze->toggleOcclusionCulling();
+		std::cout << "Occlusion culling: " << (maze->isOcclusionCullingEnabled() ? "on" : "off") << std::endl;
+	}
+
+	std::unique_lock<std::mutex> lock(reloadMutex);
+	if (reloadReady) {
+		MazeGrid grid(std::move(reloadedGrid));
+		DistanceField distances(std::move(reloadedDistances));
+		reloadReady = false;
+		lock.unlock();
+
+		maze->reload(std::move(grid), std::move(distances));
+		cameraChanged = true;	// find the hidden chunks again
+
+		// Publish the ball, which may have moved back to the start
+		reloadApplied = true;
+		glfwPostEmptyEvent();
+	}
+}
+
+/**
+ * Render frame from the latest simulation snapshot
  */
 void render() {
-	// Set up the scene and the camera
-	setProjection();
+	handleRequests();
+
+	// Only upload the view matrix (controlled by mouse) if the camera moved
+	FrameSnapshot snapshot;
+	if (simulation->readSnapshot(snapshot) && snapshot.view != viewMatrix) {
+		setView(snapshot.view);
+	}
+	maze->setDrawnBallPosition(snapshot.ballX, snapshot.ballY);
 
-	// Update the camera, and draw the scene.
+	// Draw the scene.
 	glClear( GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT );
 
-	// Store user input to update view matrix in camera
-	camera->update(Input);
+	// Draw the maze, skipping chunks the camera can't see
+	if (cameraChanged) {
+		maze->setCamera(projection, viewMatrix);
+		cameraChanged = false;
+	}
+	maze->render();
+}
 
-	// First load the viewing matrix from camera (controlled by mouse)
-	glm::mat4 viewMatrix;
-	viewMatrix = camera->getViewMtx();
-	
-	// Load it to the shader program
-	glUniformMatrix4fv( viewHandle, 1, false, glm::value_ptr(viewMatrix) );
+/**
+ * Report how many chunks of the maze were drawn, culled and hidden behind
+ * walls in the window title, followed by frame timings when profiling.
+ * The title is only changed when the counts change, or every 
+ * PROFILE_TITLE_INTERVAL seconds when profiling.
+ */
+void updateWindowTitle() {
+	bool timingsDue = profiler->isEnabled() && 
+		glfwGetTime() - profileTitleTime >= PROFILE_TITLE_INTERVAL;
 
-	// Draw the maze
-	maze->render();
+	if (!timingsDue && maze->getChunksDrawn() == titleChunksDrawn && 
+		maze->getChunksCulled() == titleChunksCulled && maze->getChunksOccluded() == titleOccluded) {
+		return;
+	}
+
+	titleChunksDrawn = maze->getChunksDrawn();
+	titleChunksCulled = maze->getChunksCulled();
+	titleOccluded = maze->getChunksOccluded();
+
+	std::stringstream title;
+	title << "Maze - chunks drawn: " << titleChunksDrawn << ", culled: " << titleChunksCulled
+		<< " | hidden behind walls: " << titleOccluded;
+	if (profiler->isEnabled()) {
+		title << " | " << profiler->overlayText();
+		profileTitleTime = glfwGetTime();
+	}
+
+	// Hand the title to the main thread and wake it up
+	std::lock_guard<std::mutex> lock(titleMutex);
+	pendingTitle = title.str();
+	titleChanged = true;
+	glfwPostEmptyEvent();
+}
+
+/**
+ * Set the window title if the render thread has changed it. Main thread only.
+ */
+void applyWindowTitle() {
+	std::lock_guard<std::mutex> lock(titleMutex);
+	if (titleChanged) {
+		glfwSetWindowTitle(window, pendingTitle.c_str());
+		titleChanged = false;
+	}
+}
+
+/**
+ * Render thread: draw frames until told to stop
+ * The OpenGL context is made current here, the main thread must not use it meanwhile.
+ */
+void renderLoop() {
+	glfwMakeContextCurrent(window);
+
+	// Always draw the first frame, after that wait for changes in on-demand mode
+	bool firstFrame = true;
+
+	while (rendering) {
+		if (onDemand && !firstFrame && !simulation->waitForSnapshot(ON_DEMAND_TIMEOUT)) {
+			continue;
+		}
+		firstFrame = false;
+
+		// Between frames, so a frame is never timed only in part
+		if (profilerToggleRequested.exchange(false)) {
+			profiler->setEnabled(!profiler->isEnabled());
+			titleChunksDrawn = -1;	// redraw the title without timings
+		}
+
+		profiler->beginFrame();
+
+		render();
+		updateWindowTitle();
+
+		// Start reading the frame back before it is swapped away
+		if (frameCapture != NULL) {
+			frameCapture->captureFrame(winX, winY);
+		}
+
+		profiler->beginPhase(PROFILE_PHASE_SWAP);
+		glfwSwapBuffers(window);
+		profiler->endPhase(PROFILE_PHASE_SWAP);
+
+		profiler->endFrame();
+		framesDrawn++;
+	}
+
+	glfwMakeContextCurrent(NULL);
 }
 
 /**
  * Check that command line args are valid
+ * Usage: maze [--bench-frames N] [--profile-csv file] [--on-demand] [--capture dir] [--solve] [--solver name] [--threads N] path/to/mazeFile
  * @param argc Number of command line args
  * @param argv Array of command line args
  * @return 0 if command line args are valid, 1 otherwise
  */
 int checkCmdLineArgs(int argc, char ** argv) {
-	// correct number of args
-	if (argc != 2) {
-		printf("Usage: maze path/to/mazeFile\n");
-		return 1;
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--bench-frames") == 0 && i+1 < argc) {
+			benchFrames = atoi(argv[++i]);
+			if (benchFrames < 1) {
+				printf("Please enter a number of benchmark frames >= 1.\n");
+				return 1;
+			}
+		} else if (strcmp(argv[i], "--profile-csv") == 0 && i+1 < argc) {
+			profileCsvPath = argv[++i];
+		} else if (strcmp(argv[i], "--capture") == 0 && i+1 < argc) {
+			captureDir = argv[++i];
+		} else if (strcmp(argv[i], "--on-demand") == 0) {
+			onDemand = true;
+		} else if (strcmp(argv[i], "--solve") == 0) {
+			solveOnly = true;
+		} else if (strcmp(argv[i], "--solver") == 0 && i+1 < argc) {
+			solver = findSolver(argv[++i]);
+			if (solver == -1) {
+				printf("Unknown solver: %s\n", argv[i]);
+				return 1;
+			}
+		} else if (strcmp(argv[i], "--threads") == 0 && i+1 < argc) {
+			int threads = atoi(argv[++i]);
+			if (threads < 1) {
+				printf("Please enter a number of solver threads >= 1.\n");
+				return 1;
+			}
+			setSolverThreads(threads);
+		} else if (mazePath == NULL && argv[i][0] != '-') {
+			mazePath = argv[i];
+		} else {
+			mazePath = NULL;
+			break;
+		}
 	}
 
-	// maze file is readable
-	std::ifstream mazeFile(argv[1]);
-	if (!mazeFile.good()) {
-		printf("File is not readable: %s\n", argv[1]);
+	// correct number of args
+	if (mazePath == NULL) {
+		printf("Usage: maze [--bench-frames N] [--profile-csv file] [--on-demand] [--capture dir] [--solve] [--solver name] [--threads N] path/to/mazeFile\n");
 		return 1;
 	}
 
@@ -155,42 +429,179 @@ int checkCmdLineArgs(int argc, char ** argv) {
 }
 
 /**
- * Create maze from file
- * If maze file is supplied and the maze has valid size, instantiate a Maze
+ * Read the maze's distance field from its cache file, or build it and
+ * write the cache for next time
+ * @param path Maze file, the cache is next to it
+ * @param grid Loaded maze
+ * @param distances Set to the maze's distances, left empty if the maze is too big
+ * @param save false to only build the field, leaving the cache to be written
+ *	the next time the maze is opened
+ */
+void findDistances(const char *path, const MazeGrid &grid, DistanceField &distances, bool save) {
+	std::string cachePath = std::string(path) + DISTANCE_FILE_SUFFIX;
+	if (distances.load(cachePath.c_str(), grid)) {
+		return;
+	}
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	if (!distances.build(grid)) {
+		printf("No hints for this maze, it is too big\n");
+		return;
+	}
+	std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+	printf("Found the distance to the goal of every square in %.1f ms\n", elapsed.count());
+	if (!save) {
+		return;
+	}
+
+	std::string error;
+	if (!distances.save(cachePath.c_str(), grid, error)) {
+		printf("Couldn't cache the distances: %s\n", error.c_str());
+	}
+}
+
+/**
+ * Load and check the maze file, before any window is opened
  * @param filePath Path to file that defines maze
- * @return 0 if maze can be created, 1 otherwise
+ * @return 0 if the maze file is valid, 1 otherwise
  */
-int createMaze(char* filePath) {
-	// open stream to file
-	std::ifstream fileStream(filePath);
-	if (fileStream == NULL) {
-		printf("Couldn't open file stream to: %s\n", filePath);
+int loadMaze(char* filePath) {
+	std::string error;
+	if (isMazeTiledFile(filePath)) {
+		tileStore = new TileStore();
+		if (!tileStore->open(filePath, error)) {
+			printf("Invalid maze file: %s\n", error.c_str());
+			return 1;
+		}
+		return 0;
+	}
+
+	if (!loadMazeFile(filePath, mazeGrid, error)) {
+		printf("Invalid maze file: %s\n", error.c_str());
 		return 1;
 	}
 
-	// check size of maze
-	std::string mazeLine;
-	int gridSize;
-	getline(fileStream, mazeLine);
-	std::stringstream(mazeLine) >> gridSize;
-	if (gridSize < 2) {
-		printf("Please enter a maze size >= 2.\n");
+	if (solveOnly) {
+		return 0;
+	}
+
+	// The file is watched while playing, and may be rewritten under a mapping
+	if (benchFrames == 0) {
+		mazeGrid.detach();
+	}
+
+	// Every move is then one lookup
+	mazeGrid.buildSlideTable();
+
+	// Hints and the stuck warning are only needed while playing
+	if (benchFrames == 0) {
+		findDistances(filePath, mazeGrid, mazeDistances, true);
+	}
+
+	return 0;
+}
+
+/**
+ * Instantiate the Maze, which takes over the loaded grid or pages in the tiled maze
+ */
+void createMaze() {
+	if (tileStore != NULL) {
+		maze = new Maze(tileStore, mazeWidth, programIDs);
+	} else {
+		maze = new Maze(std::move(mazeGrid), mazeWidth, programIDs);
+		maze->distances = std::move(mazeDistances);
+	}
+}
+
+/**
+ * Load the maze file again after it changed, and hand it to the render thread
+ * Runs on the watcher's thread. A file that doesn't load is reported and
+ * the maze being played is kept.
+ */
+void mazeFileChanged() {
+	MazeGrid grid;
+	std::string error;
+	if (!loadMazeFile(mazePath, grid, error)) {
+		printf("Maze not reloaded: %s\n", error.c_str());
+		return;
+	}
+	grid.detach();
+
+	// The whole field is found again, about a second at DISTANCE_FIELD_MAX_SIZE,
+	// but this is the watcher's thread so the game doesn't wait for it. The
+	// cache isn't written for every edit, only when the maze is next opened.
+	DistanceField distances;
+	findDistances(mazePath, grid, distances, false);
+
+	{
+		std::lock_guard<std::mutex> lock(reloadMutex);
+		reloadedGrid = std::move(grid);
+		reloadedDistances = std::move(distances);
+		reloadReady = true;
+	}
+	reloadRedrawRequested = true;
+	glfwPostEmptyEvent();
+}
+
+/**
+ * Watch the maze file while playing, paged mazes are too big to reload
+ */
+void watchMazeFile() {
+	if (tileStore != NULL) {
+		return;
+	}
+
+	mazeWatcher = new FileWatcher(mazePath);
+	if (!mazeWatcher->start(mazeFileChanged)) {
+		printf("Couldn't watch maze file for changes: %s\n", mazePath);
+		delete mazeWatcher;
+		mazeWatcher = NULL;
+	}
+}
+
+/**
+ * Print the fewest moves from the start to the goal
+ * @return 0 if the maze has a solution, 1 otherwise
+ */
+int solve() {
+	if (tileStore != NULL) {
+		printf("Tiled mazes are too big to solve\n");
 		return 1;
 	}
 
-	// read maze specification from file
-	std::vector<std::string> grid;
-	for (int row = 0; row < gridSize; row++) {
-		getline(fileStream, mazeLine);
-		grid.push_back(mazeLine);
+	Solution solution;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	solveMaze(mazeGrid, solver, solution);
+	std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+
+	if (!solution.solved) {
+		printf("No solution: the goal can't be reached (%s searched %ld squares in %.1f ms)\n",
+			getSolverName(solver), solution.statesExpanded, elapsed.count());
+		return 1;
 	}
 
-	maze = new Maze(grid, mazeWidth, programID);
-	gameManager = new GameManager(maze);
+	printf("Solved in %d moves (%s searched %ld squares in %.1f ms)\n", (int)solution.moves.size(),
+		getSolverName(solver), solution.statesExpanded, elapsed.count());
 
+	const char directionLetters[DIRECTION_COUNT + 1] = "NESW";
+	std::string moves;
+	for (int i = 0; i < solution.moves.size(); i++) {
+		moves += directionLetters[solution.moves[i]];
+	}
+	printf("%s\n", moves.c_str());
 	return 0;
 }
 
+/**
+ * Report how the tiles of a paged maze were read
+ */
+void printTileStats() {
+	if (tileStore != NULL) {
+		printf("Tiles: %ld read ahead, %ld read when needed, %ld already in memory, %ld evicted\n",
+			tileStore->getPrefetched(), tileStore->getMisses(), tileStore->getHits(), tileStore->getEvicted());
+	}
+}
+
 
 /**
  * Sets up the GLFW window before rendering starts
@@ -226,20 +637,134 @@ void setupGLFWWindow() {
 }
 
 /**
- * Load shader required for the maze, and find uniform variables
+ * Find a percentile of sorted samples
+ * @param sorted Samples in ascending order
+ * @param percentile Percentile from 0 to 100
+ */
+double percentile(std::vector<double> &sorted, double percentile) {
+	int index = (int)(percentile / 100.0 * (sorted.size() - 1) + 0.5);
+	return sorted[index];
+}
+
+/**
+ * Render frames offscreen while orbiting the camera once around the maze,
+ * then print frame times and draw calls as JSON.
+ * Each frame is timed until the GPU has finished drawing it.
+ * @param frames Number of frames to render
+ */
+void runBenchmark(int frames) {
+	std::vector<double> frameTimes;
+	long totalDrawCalls = 0;
+	int minDrawCalls = 0, maxDrawCalls = 0;
+
+	// Scripted orbit: drag the mouse far enough for one full turn over all frames
+	// The simulation is stepped once per frame on this thread, so runs are repeatable
+	float mouseX = 0.0f;
+	float mouseStep = 360.0f / 0.6f / (float)frames;
+	InputEvent press = { INPUT_EVENT_MOUSE_BUTTON, 0, 0.0f, true };
+	simulation->post(press);
+
+	for (int frame = 0; frame < frames; frame++) {
+		mouseX += mouseStep;
+		InputEvent move = { INPUT_EVENT_MOUSE_MOVE, 0, mouseX, false };
+		simulation->post(move);
+		simulation->step();
+
+		profiler->beginFrame();
+
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		render();
+		if (frameCapture != NULL) {
+			frameCapture->captureFrame(winX, winY);
+		}
+		glFinish();
+		std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+		profiler->endFrame();
+
+		frameTimes.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+
+		int drawCalls = maze->getDrawCalls();
+		totalDrawCalls += drawCalls;
+		if (frame == 0 || drawCalls < minDrawCalls) {
+			minDrawCalls = drawCalls;
+		}
+		if (frame == 0 || drawCalls > maxDrawCalls) {
+			maxDrawCalls = drawCalls;
+		}
+	}
+
+	std::sort(frameTimes.begin(), frameTimes.end());
+
+	std::cout << "{\"maze\": \"" << mazePath << "\""
+		<< ", \"renderMode\": \"" << maze->getRenderModeName() << "\""
+		<< ", \"renderer\": \"" << glGetString(GL_RENDERER) << "\""
+		<< ", \"frames\": " << frames
+		<< ", \"frameTimeMs\": {\"min\": " << frameTimes.front()
+		<< ", \"median\": " << percentile(frameTimes, 50.0)
+		<< ", \"p99\": " << percentile(frameTimes, 99.0) << "}"
+		<< ", \"drawCalls\": {\"min\": " << minDrawCalls
+		<< ", \"max\": " << maxDrawCalls
+		<< ", \"mean\": " << (double)totalDrawCalls / frames << "}"
+		<< ", \"programBinds\": " << maze->getProgramBinds()
+		<< ", \"occlusion\": {\"hidden\": " << maze->getOccludedCount()
+		<< ", \"visible\": " << maze->getUnoccludedCount()
+		<< ", \"chunks\": " << maze->getChunksOccluded() << "}}" << std::endl;
+}
+
+/**
+ * Load a shader variant for each render stage of the maze, and create the
+ * camera uniform buffer they all share
+ * Every variant is compiled and linked before any result is checked, so the
+ * driver can work on them all at once. Each is finished as soon as it is ready.
  */
 void setupShader() {
-	// Set up the shaders we are to use. 0 indicates error.
-	programID = LoadShaders("maze.vert", "maze.frag");
-	if (programID == 0) {
-		exit(1);
+	ShaderBuild builds[RENDER_STAGE_COUNT];
+	for (int stage = 0; stage < RENDER_STAGE_COUNT; stage++) {
+		std::ostringstream defines;
+		defines << "#define RENDER_STAGE " << stage << "\n";
+		if (!BeginShaders("maze.vert", "maze.frag", defines.str().c_str(), builds[stage])) {
+			exit(1);
+		}
+		programIDs[stage] = 0;
 	}
 
-	// Get handle to view matrix to control camera
-	viewHandle = glGetUniformLocation(programID, "view");
-	if (viewHandle == -1) {
-		std::cout << "Uniform: view is not an active uniform label\n";
+	int finished = 0;
+	while (finished < RENDER_STAGE_COUNT) {
+		bool waiting = true;
+		for (int stage = 0; stage < RENDER_STAGE_COUNT; stage++) {
+			if (programIDs[stage] != 0 || !ShaderBuildDone(builds[stage])) {
+				continue;
+			}
+
+			// Set up the shaders we are to use. 0 indicates error.
+			programIDs[stage] = FinishShaders(builds[stage]);
+			if (programIDs[stage] == 0) {
+				exit(1);
+			}
+			finished++;
+			waiting = false;
+
+			// Connect the shader's Camera block to the camera uniform buffer
+			unsigned int cameraBlockIndex = glGetUniformBlockIndex(programIDs[stage], "Camera");
+			if (cameraBlockIndex == GL_INVALID_INDEX) {
+				std::cout << "Uniform block: Camera is not an active uniform block\n";
+				exit(1);
+			}
+			glUniformBlockBinding(programIDs[stage], cameraBlockIndex, CAMERA_BLOCK_BINDING);
+		}
+
+		if (waiting) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
 	}
+
+	// Projection then view matrix
+	glGenBuffers(1, &cameraBufferHandle);
+	glBindBuffer(GL_UNIFORM_BUFFER, cameraBufferHandle);
+	glBufferData(GL_UNIFORM_BUFFER, 2*sizeof(glm::mat4), NULL, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	glBindBufferBase(GL_UNIFORM_BUFFER, CAMERA_BLOCK_BINDING, cameraBufferHandle);
 }
 
 /**
@@ -253,44 +778,145 @@ int main (int argc, char **argv) {
 		return 0;
 	}
 
-	setupGLFWWindow();
+	if (loadMaze(mazePath) == 1) {
+		return 1;
+	}
+
+	// Solving doesn't need a window or OpenGL
+	if (solveOnly) {
+		return solve();
+	}
+
+	// Benchmarks render offscreen, so they also run on machines without a display
+	if (benchFrames > 0) {
+		if (!createHeadlessContext(winX, winY)) {
+			exit(1);
+		}
+	} else {
+		setupGLFWWindow();
+	}
 	
 	// Initialize GLEW
+	// Without a display GLEW can't load GLX, which the offscreen context doesn't need
 	glewExperimental = true; // Needed for core profile
-	if (glewInit() != GLEW_OK) {
+	GLenum glewStatus = glewInit();
+	if (glewStatus != GLEW_OK && !(benchFrames > 0 && glewStatus == GLEW_ERROR_NO_GLX_DISPLAY)) {
 		fprintf(stderr, "Failed to initialize GLEW\n");
 		exit(1);
 	}
 
 	setupShader();
 
-	// Create maze from file
-	if (createMaze(argv[1]) == 1) {
-		return 0;
-	}
+	// Create maze from the loaded file
+	createMaze();
 
-	// Create camera that can be controlled by user
+	// Create the game and a camera that can be controlled by user
 	glm::vec3 initialCameraPos(0.0f, 1.05f*mazeWidth, 1.05f*mazeWidth);
-	camera = new ObjectViewer(initialCameraPos);
+	simulation = new Simulation(maze, initialCameraPos);
+
+	// Upload the initial camera, after this it is only uploaded when it changes
+	FrameSnapshot snapshot;
+	simulation->readSnapshot(snapshot);
+	setProjection();
+	setView(snapshot.view);
+
+	// Profiling is toggled with P, or always on when writing a CSV file
+	profiler = new Profiler();
+	maze->setProfiler(profiler);
+	if (profileCsvPath != NULL) {
+		if (!profiler->openCsv(profileCsvPath)) {
+			printf("Couldn't open profile file: %s\n", profileCsvPath);
+			exit(1);
+		}
+		profiler->setEnabled(true);
+	}
+
+	// Record frames for QA
+	if (captureDir != NULL) {
+		frameCapture = new FrameCapture(captureDir);
+		if (!frameCapture->start()) {
+			printf("Couldn't create capture directory: %s\n", captureDir);
+			exit(1);
+		}
+	}
 
 	// Set OpenGL state we need for this application.
 	glClearColor(0.5F, 0.5F, 0.5F, 0.0F);
 	glEnable(GL_DEPTH_TEST);
 
+	if (benchFrames > 0) {
+		runBenchmark(benchFrames);
+
+		if (frameCapture != NULL) {
+			frameCapture->stop();
+			frameCapture->printStats();
+			delete frameCapture;
+		}
+		delete profiler;
+		delete simulation;
+		delete maze;
+		destroyHeadlessContext();
+
+		printTileStats();
+		delete tileStore;
+
+		return 0;
+	}
+
+	// Hand the OpenGL context to the render thread and start the simulation
+	glfwMakeContextCurrent(NULL);
+	simulation->start();
+	rendering = true;
+	renderThread = std::thread(renderLoop);
+	double startTime = glfwGetTime();
+	watchMazeFile();
+
+	// Wait for window events, which are passed to the other threads
 	while (!glfwWindowShouldClose(window)) {
-		render();
+		glfwWaitEvents();
+		applyWindowTitle();
+
+		// Wake the render thread to replace the maze, then draw the result
+		if (reloadRedrawRequested.exchange(false)) {
+			requestRedraw();
+		}
+		if (reloadApplied.exchange(false)) {
+			InputEvent event = { INPUT_EVENT_RELOADED, 0, 0.0f, false };
+			simulation->post(event);
+		}
+	}
 
-		glfwSwapBuffers(window);
-		glfwPollEvents();
+	delete mazeWatcher;
+	rendering = false;
+	requestRedraw();	// wake the render thread if it is waiting for a change
+	renderThread.join();
+	simulation->stop();
+	glfwMakeContextCurrent(window);
+
+	// Compare with the frames a vsync-limited loop would have drawn
+	if (onDemand) {
+		const GLFWvidmode *videoMode = glfwGetVideoMode(glfwGetPrimaryMonitor());
+		int refreshRate = (videoMode != NULL && videoMode->refreshRate > 0) ? videoMode->refreshRate : 60;
+		int vsyncFrames = (int)((glfwGetTime() - startTime) * refreshRate);
+		int skipped = std::max(0, vsyncFrames - framesDrawn);
+		printf("On-demand rendering: drew %d frames, skipped %d (of %d at %d Hz)\n",
+			framesDrawn, skipped, vsyncFrames, refreshRate);
 	}
 
 	// Cleanup    
+	if (frameCapture != NULL) {
+		frameCapture->stop();
+		frameCapture->printStats();
+		delete frameCapture;
+	}
+	delete profiler;
+	delete simulation;
+	delete maze;
 	glfwDestroyWindow(window);
 	glfwTerminate();
 
-	delete camera;
-	delete gameManager;
-	delete maze;
+	printTileStats();
+	delete tileStore;
 	
 	return 0;
 }
@@ -1,41 +1,39 @@
-// One megashader for floor, blocks, goal and ball due to bugs with multiple shaders.
+// One shader source for floor, blocks, goal and ball.
+// Compiled once per render stage, with RENDER_STAGE defined by the program
+// (see Maze.h), so no fragment has to branch on which stage it belongs to.
 
 #version 330
 
+#define RENDER_STAGE_FLOOR 0
+#define RENDER_STAGE_BLOCKS 1
+#define RENDER_STAGE_GOAL 2
+#define RENDER_STAGE_BALL 3
+#define RENDER_STAGE_BAKED 4
+
 in vec4 pos;
+#if RENDER_STAGE == RENDER_STAGE_BAKED
+// Floor or blocks, from the baked vertex
+flat in int stage;
+#endif
 
 // The final colour we will see at this location on screen
 out vec4 fragColour;
 
-// Which part of the maze we are rendering
-uniform int renderStage;
-
+#if RENDER_STAGE == RENDER_STAGE_GOAL || RENDER_STAGE == RENDER_STAGE_BALL
 // Radius of goal and ball
 uniform float sphereRadius;
+#else
 // "Radius" of square on top of blocks and floor tiles
 uniform float squareRadius;
+// Width of one grid square
+uniform float cellWidth;
+#endif
 
-#define RENDER_STAGE_FLOOR 0
-#define RENDER_STAGE_BLOCKS 1
-#define RENDER_STAGE_GOAL 2
-#define RENDER_STAGE_BALL 3
-
-/*
- * Determine fragment colour by the xz position on the cube
- * Use squares to make a 'tiled' appearance to make structure of the maze clear
- * @param tileColour Colour in the square on top of the cube
- * @param sideColour Colour outside of the square on top of the cube
- * @return Colour for this part of the cube
- */
-vec4 cubeColour(in vec4 tileColour, in vec4 sideColour) {
-	if (pos.x < squareRadius && pos.x > -squareRadius && 
-		pos.z < squareRadius && pos.z > -squareRadius) {
-		return tileColour;
-	} else {
-		return sideColour;
-	}
-}
+const vec4 darkPurple = vec4(0.2, 0.0, 0.6, 1.0);
+const vec4 yellow = vec4(1.0f, 0.75f, 0.0f, 1.0f);
+const vec4 purple = vec4(0.67f, 0.04f, 0.83f, 1.0f);
 
+#if RENDER_STAGE == RENDER_STAGE_GOAL || RENDER_STAGE == RENDER_STAGE_BALL
 /*
  * Determine fragment colour by the y position of this fragment in the sphere
  * Use a gradient for a basic 3D appearance
@@ -49,37 +47,50 @@ vec4 sphereColour(in vec4 lowerColour, in vec4 upperColour) {
 
 	return mix(lowerColour, upperColour, lerpValue);
 }
+#else
+/*
+ * Determine fragment colour by the xz position on the cube
+ * Use squares to make a 'tiled' appearance to make structure of the maze clear
+ * Baked faces span several grid squares, so the position is wrapped to one square
+ * @param tileColour Colour in the square on top of the cube
+ * @param sideColour Colour outside of the square on top of the cube
+ * @return Colour for this part of the cube
+ */
+vec4 cubeColour(in vec4 tileColour, in vec4 sideColour) {
+	vec2 tilePos = mod(pos.xz + 0.5*cellWidth, cellWidth) - 0.5*cellWidth;
+
+	if (tilePos.x < squareRadius && tilePos.x > -squareRadius && 
+		tilePos.y < squareRadius && tilePos.y > -squareRadius) {
+		return tileColour;
+	} else {
+		return sideColour;
+	}
+}
+#endif
 
 void main(void) {
-	vec4 darkPurple = vec4(0.2, 0.0, 0.6, 1.0);
+	// different rendering style for each of the components of the maze
+#if RENDER_STAGE == RENDER_STAGE_FLOOR
+	fragColour = cubeColour(yellow, darkPurple);
 
-	// different rendering style for each of the 4 components of the maze
-	switch(renderStage) {
-		case RENDER_STAGE_FLOOR:
-			vec4 yellow = vec4(1.0f, 0.75f, 0.0f, 1.0f);
-			fragColour = cubeColour(yellow, darkPurple);
-			break;
+#elif RENDER_STAGE == RENDER_STAGE_BLOCKS
+	fragColour = cubeColour(purple, darkPurple);
 
-		case RENDER_STAGE_BLOCKS:
-			vec4 purple = vec4(0.67f, 0.04f, 0.83f, 1.0f);
-			fragColour = cubeColour(purple, darkPurple);
-			break;
+#elif RENDER_STAGE == RENDER_STAGE_BAKED
+	// stage is flat, so this is the same for every fragment of a triangle
+	fragColour = cubeColour(stage == RENDER_STAGE_FLOOR ? yellow : purple, darkPurple);
 
-		case RENDER_STAGE_GOAL:
-			vec4 green = vec4(0.2f, 0.8f, 0.2f, 1.0f);
-			vec4 darkGreen = vec4(0.0f, 0.5f, 0.0f, 1.0f);
-			fragColour = sphereColour(darkGreen, green);
-			break;
+#elif RENDER_STAGE == RENDER_STAGE_GOAL
+	vec4 green = vec4(0.2f, 0.8f, 0.2f, 1.0f);
+	vec4 darkGreen = vec4(0.0f, 0.5f, 0.0f, 1.0f);
+	fragColour = sphereColour(darkGreen, green);
 
-		case RENDER_STAGE_BALL:
-			vec4 red = vec4(1.0f, 0.0f, 0.1f, 1.0f);
-			vec4 darkRed = vec4(0.5f, 0.0f, 0.0f, 0.1f);
-			fragColour = sphereColour(darkRed, red);
-			break;
+#elif RENDER_STAGE == RENDER_STAGE_BALL
+	vec4 red = vec4(1.0f, 0.0f, 0.1f, 1.0f);
+	vec4 darkRed = vec4(0.5f, 0.0f, 0.0f, 0.1f);
+	fragColour = sphereColour(darkRed, red);
 
-		default:
-			vec4 white = vec4(1.0f, 1.0f, 1.0f, 1.0f);
-			fragColour = white;
-			break;
-	}
+#else
+	fragColour = vec4(1.0f, 1.0f, 1.0f, 1.0f);
+#endif
 }
@@ -1,10 +1,33 @@
 #version 330
 
+// Compiled once per render stage, with RENDER_STAGE defined by the program
+// (see Maze.h). Each variant only contains the code for its own stage.
+
+#define RENDER_STAGE_FLOOR 0
+#define RENDER_STAGE_BLOCKS 1
+#define RENDER_STAGE_GOAL 2
+#define RENDER_STAGE_BALL 3
+#define RENDER_STAGE_BAKED 4
+
 // Position. 1 per vertex.
 layout (location = 0) in vec3 a_vertex; 
+// Translation of this instance. 1 per instance, (0,0,0) when not instancing.
+layout (location = 1) in vec3 a_offset;
+
+#if RENDER_STAGE == RENDER_STAGE_BAKED
+// Render stage of the baked static world. 1 per vertex.
+layout (location = 2) in float a_stage;
+
+// Floor or blocks, for the fragment shader
+flat out int stage;
+#endif
+
+// Camera matrices, shared by every draw and only uploaded when they change
+layout (std140) uniform Camera {
+	mat4 projection;
+	mat4 view;
+};
 
-uniform mat4 projection;
-uniform mat4 view;
 uniform mat4 model;
 
 out vec4 pos;
@@ -13,6 +36,10 @@ void main(void) {
 	// pass object coordinates to frag shader
 	pos = vec4(a_vertex, 1.0);
 
+#if RENDER_STAGE == RENDER_STAGE_BAKED
+	stage = int(a_stage);
+#endif
+
 	// clip-space position
-	gl_Position = projection * view * model * vec4(a_vertex, 1.0);
+	gl_Position = projection * view * (model * vec4(a_vertex, 1.0) + vec4(a_offset, 0.0));
 }